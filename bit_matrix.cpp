@@ -0,0 +1,103 @@
+#include "bit_matrix.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+
+namespace {
+std::vector<BitMatrix::RowMask> ToRowMasks(const std::vector<uint64_t> &v) {
+  std::vector<BitMatrix::RowMask> result(v.size());
+  std::transform(v.begin(), v.end(), result.begin(),
+                 [](uint64_t x) { return BitMatrix::RowMask{x, 0}; });
+  return result;
+}
+
+std::size_t BitWidth(const BitMatrix::RowMask &row) {
+  return row[1] != 0 ? 64 + std::bit_width(row[1]) : std::bit_width(row[0]);
+}
+
+BitMatrix::RowMask AllColumns(const std::vector<BitMatrix::RowMask> &v) {
+  std::size_t num_columns = 0;
+  for (const auto &row : v) {
+    num_columns = std::max(num_columns, BitWidth(row));
+  }
+  BitMatrix::RowMask result = {};
+  for (std::size_t col = 0; col < num_columns; ++col) {
+    result[col / 64] |= uint64_t{1} << (col % 64);
+  }
+  return result;
+}
+} // namespace
+
+BitMatrix::BitMatrix(const std::vector<uint64_t> &v)
+    : BitMatrix(ToRowMasks(v)) {}
+
+BitMatrix::BitMatrix(const std::vector<RowMask> &v)
+    : BitMatrix(v, AllColumns(v)) {}
+
+BitMatrix::BitMatrix(const std::vector<RowMask> &v, RowMask primary_columns)
+    : primary(primary_columns), rows(v), row_to_group(v.size(), -1) {
+  for (const auto &row : rows) {
+    m_num_columns = std::max(m_num_columns, BitWidth(row));
+  }
+  m_num_columns = std::max(m_num_columns, BitWidth(primary));
+  num_words = (rows.size() + 255) / 256 * 4;
+
+  col_rows.assign(m_num_columns * num_words, 0);
+  for (std::size_t row = 0; row < rows.size(); ++row) {
+    for (std::size_t half = 0; half < 2; ++half) {
+      for (uint64_t bits = rows[row][half]; bits != 0; bits &= bits - 1) {
+        const std::size_t col = half * 64 + std::countr_zero(bits);
+        col_rows[col * num_words + row / 64] |= uint64_t{1} << (row % 64);
+      }
+    }
+  }
+
+  row_conflicts.assign(rows.size() * num_words, 0);
+  row_conflicts_ready.assign(rows.size(), false);
+}
+
+void BitMatrix::AddConflict(std::size_t row_a, std::size_t row_b) {
+  row_conflicts[row_a * num_words + row_b / 64] |= uint64_t{1} << (row_b % 64);
+  row_conflicts[row_b * num_words + row_a / 64] |= uint64_t{1} << (row_a % 64);
+}
+
+void BitMatrix::LimitRows(std::size_t first_row, std::size_t last_row,
+                          std::size_t capacity) {
+  const int32_t group = groups.size();
+  groups.push_back(RowGroup{capacity});
+  group_rows.resize(groups.size() * num_words);
+  for (std::size_t row = first_row; row < last_row; ++row) {
+    row_to_group[row] = group;
+    group_rows[group * num_words + row / 64] |= uint64_t{1} << (row % 64);
+  }
+}
+
+bool SolveCoverProblem(BitMatrix &bit_matrix,
+                       std::vector<std::size_t> &solution) {
+  bool found_solution = false;
+  bit_matrix.Search(
+      [&]() {
+        found_solution = true;
+        return false;
+      },
+      [&](std::size_t row) { solution.push_back(row); },
+      [&]() {
+        if (!found_solution) {
+          solution.pop_back();
+        }
+      });
+  return found_solution;
+}
+
+void ExhaustiveSolveCoverProblem(
+    BitMatrix &bit_matrix, std::vector<std::vector<std::size_t>> &solutions) {
+  std::vector<std::size_t> solution;
+  bit_matrix.Search(
+      [&]() {
+        solutions.push_back(solution);
+        return true;
+      },
+      [&](std::size_t row) { solution.push_back(row); },
+      [&]() { solution.pop_back(); });
+}
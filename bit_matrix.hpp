@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <immintrin.h>
+
+// Exact cover matrix for problems with at most 128 columns. Instead of linked
+// entries every column keeps the set of rows it contains as a bitset, and the
+// search state is the bitset of rows that are still active. Choosing a row is
+// a single AND-NOT of the active rows with the rows conflicting with it, undo
+// is a pop of the per-level copy of the active rows.
+class BitMatrix {
+public:
+  static constexpr std::size_t kMaxColumns = 128;
+  // bit i of the 128 bit number {lo, hi} is set if the row covers column i
+  using RowMask = std::array<uint64_t, 2>;
+
+  // v is a vector of bitmasks, every column below the highest set bit has to
+  // be covered.
+  explicit BitMatrix(const std::vector<uint64_t> &v);
+  explicit BitMatrix(const std::vector<RowMask> &v);
+  // Only the columns set in primary_columns have to be covered, the others
+  // may be covered at most once.
+  BitMatrix(const std::vector<RowMask> &v, RowMask primary_columns);
+
+  // Forbids selecting both rows in the same solution, e.g. to order the
+  // placements of identical pieces.
+  void AddConflict(std::size_t row_a, std::size_t row_b);
+  // At most capacity of the rows in [first_row, last_row) can be selected,
+  // e.g. the placements of a piece that appears capacity times. Row ranges
+  // of different calls must not overlap.
+  void LimitRows(std::size_t first_row, std::size_t last_row,
+                 std::size_t capacity);
+
+  std::size_t num_rows() const { return rows.size(); }
+  std::size_t num_columns() const { return m_num_columns; }
+
+private:
+  // number of uint64_t in a row bitset, multiple of 4 so that a row bitset is
+  // a whole number of __m256i
+  std::size_t num_words{};
+  std::size_t m_num_columns{};
+  RowMask primary{};
+
+  std::vector<RowMask> rows;
+  // col_rows[col * num_words + w]: rows containing col
+  std::vector<uint64_t> col_rows;
+  // row_conflicts[row * num_words + w]: rows sharing a column with row, only
+  // filled in once the row gets selected for the first time
+  std::vector<uint64_t> row_conflicts;
+  std::vector<bool> row_conflicts_ready;
+  // active rows for every search depth
+  std::vector<uint64_t> active_stack;
+
+  struct RowGroup {
+    std::size_t remaining;
+    // group_rows[group * num_words + w]: rows of the group
+  };
+  std::vector<RowGroup> groups;
+  std::vector<uint64_t> group_rows;
+  // -1 if the row is not limited
+  std::vector<int32_t> row_to_group;
+
+  uint64_t number_of_times_stuck{};
+
+  const uint64_t *col_bits(std::size_t col) const {
+    return &col_rows[col * num_words];
+  }
+  const uint64_t *conflict_bits(std::size_t row) {
+    uint64_t *conflicts = &row_conflicts[row * num_words];
+    if (!row_conflicts_ready[row]) {
+      row_conflicts_ready[row] = true;
+      for (std::size_t half = 0; half < 2; ++half) {
+        for (uint64_t bits = rows[row][half]; bits != 0; bits &= bits - 1) {
+          const uint64_t *c = col_bits(half * 64 + std::countr_zero(bits));
+          for (std::size_t w = 0; w < num_words; ++w) {
+            conflicts[w] |= c[w];
+          }
+        }
+      }
+    }
+    return conflicts;
+  }
+  uint64_t *active(std::size_t depth) {
+    return &active_stack[depth * num_words];
+  }
+
+  // stops counting once limit is reached
+  std::size_t ActiveRowsInColumn(std::size_t col, const uint64_t *active_rows,
+                                 std::size_t limit) const {
+    const uint64_t *c = col_bits(col);
+    std::size_t result = 0;
+    for (std::size_t w = 0; w < num_words && result < limit; w += 4) {
+      result += std::popcount(c[w] & active_rows[w]) +
+                std::popcount(c[w + 1] & active_rows[w + 1]) +
+                std::popcount(c[w + 2] & active_rows[w + 2]) +
+                std::popcount(c[w + 3] & active_rows[w + 3]);
+    }
+    return result;
+  }
+
+  void SelectRow(std::size_t row, const uint64_t *active_rows,
+                 uint64_t *next_active_rows) {
+    const uint64_t *conflicts = conflict_bits(row);
+    for (std::size_t w = 0; w < num_words; w += 4) {
+      const __m256i a = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(active_rows + w));
+      const __m256i c =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(conflicts + w));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(next_active_rows + w),
+                          _mm256_andnot_si256(c, a));
+    }
+  }
+
+  // return true if we should continue exploring
+  template <typename ON_SOL, typename ON_TRY, typename ON_UNDO>
+  bool Recurse(std::size_t depth, RowMask uncovered, ON_SOL &&on_sol,
+               ON_TRY &&on_try, ON_UNDO &&on_undo) {
+    if ((uncovered[0] & primary[0]) == 0 && (uncovered[1] & primary[1]) == 0) {
+      return on_sol();
+    }
+    const uint64_t *active_rows = active(depth);
+    std::size_t min_col = kMaxColumns;
+    std::size_t min_col_size = std::numeric_limits<std::size_t>::max();
+    for (std::size_t half = 0; half < 2 && min_col_size > 1; ++half) {
+      for (uint64_t bits = uncovered[half] & primary[half]; bits != 0;
+           bits &= bits - 1) {
+        const std::size_t col = half * 64 + std::countr_zero(bits);
+        const auto col_size = ActiveRowsInColumn(col, active_rows, min_col_size);
+        if (col_size < min_col_size) {
+          min_col_size = col_size;
+          min_col = col;
+          if (col_size <= 1) {
+            break;
+          }
+        }
+      }
+    }
+    if (min_col_size == 0) {
+      ++number_of_times_stuck;
+      return true;
+    }
+    const uint64_t *c = col_bits(min_col);
+    for (std::size_t w = 0; w < num_words; ++w) {
+      for (uint64_t bits = c[w] & active(depth)[w];
+           bits != 0; bits &= bits - 1) {
+        const std::size_t row = w * 64 + std::countr_zero(bits);
+        SelectRow(row, active(depth), active(depth + 1));
+        const int32_t group = row_to_group[row];
+        if (group != -1 && --groups[group].remaining == 0) {
+          uint64_t *next_active_rows = active(depth + 1);
+          for (std::size_t i = 0; i < num_words; ++i) {
+            next_active_rows[i] &= ~group_rows[group * num_words + i];
+          }
+        }
+        on_try(row);
+        const RowMask next_uncovered = {uncovered[0] & ~rows[row][0],
+                                        uncovered[1] & ~rows[row][1]};
+        const bool keep_going =
+            Recurse(depth + 1, next_uncovered, on_sol, on_try, on_undo);
+        on_undo();
+        if (group != -1) {
+          ++groups[group].remaining;
+        }
+        if (!keep_going) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  template <typename ON_SOL, typename ON_TRY, typename ON_UNDO>
+  void Search(ON_SOL &&on_sol, ON_TRY &&on_try, ON_UNDO &&on_undo) {
+    // every level covers at least one primary column
+    const std::size_t max_depth =
+        std::popcount(primary[0]) + std::popcount(primary[1]);
+    active_stack.assign((max_depth + 1) * num_words, 0);
+    uint64_t *active_rows = active(0);
+    for (std::size_t row = 0; row < rows.size(); ++row) {
+      const int32_t group = row_to_group[row];
+      if (group == -1 || groups[group].remaining > 0) {
+        active_rows[row / 64] |= uint64_t{1} << (row % 64);
+      }
+    }
+    RowMask uncovered = {};
+    for (std::size_t col = 0; col < m_num_columns; ++col) {
+      uncovered[col / 64] |= uint64_t{1} << (col % 64);
+    }
+    Recurse(0, uncovered, on_sol, on_try, on_undo);
+  }
+
+  friend bool SolveCoverProblem(BitMatrix &bit_matrix,
+                                std::vector<std::size_t> &rows);
+  friend void
+  ExhaustiveSolveCoverProblem(BitMatrix &bit_matrix,
+                              std::vector<std::vector<std::size_t>> &solutions);
+};
+
+bool SolveCoverProblem(BitMatrix &bit_matrix, std::vector<std::size_t> &rows);
+
+void ExhaustiveSolveCoverProblem(
+    BitMatrix &bit_matrix, std::vector<std::vector<std::size_t>> &solutions);
@@ -0,0 +1,82 @@
+#include "bit_matrix.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+TEST(BitMatrix, Empty) {
+  std::vector<uint64_t> v;
+  BitMatrix bit_matrix(v);
+  ASSERT_EQ(bit_matrix.num_rows(), 0u);
+  ASSERT_EQ(bit_matrix.num_columns(), 0u);
+}
+
+TEST(BitMatrix, SolveCoverProblem) {
+  std::vector<uint64_t> v = {
+      0b10,
+      0b11,
+  };
+  std::vector<std::size_t> rows;
+  BitMatrix bit_matrix(v);
+  ASSERT_TRUE(SolveCoverProblem(bit_matrix, rows));
+  ASSERT_THAT(rows, testing::ElementsAre(1));
+}
+
+TEST(BitMatrix, SolveCoverProblemNoSolution) {
+  std::vector<uint64_t> v = {
+      0b100,
+      0b101,
+  };
+  std::vector<std::size_t> rows;
+  BitMatrix bit_matrix(v);
+  ASSERT_FALSE(SolveCoverProblem(bit_matrix, rows));
+  ASSERT_TRUE(rows.empty());
+}
+
+TEST(BitMatrix, SolveCoverProblemTricky) {
+  std::vector<uint64_t> v = {
+      0b1001001, 0b1001000, 0b0001101, 0b0010110, 0b0110011, 0b0100001,
+  };
+  std::vector<std::size_t> rows;
+  BitMatrix bit_matrix(v);
+  ASSERT_TRUE(SolveCoverProblem(bit_matrix, rows));
+  ASSERT_THAT(rows, testing::UnorderedElementsAre(1, 3, 5));
+}
+
+TEST(BitMatrix, WideColumns) {
+  // columns 0, 63, 64 and 127, rows 0 and 3 cover everything once
+  std::vector<BitMatrix::RowMask> v = {
+      {uint64_t{1} | (uint64_t{1} << 63), uint64_t{1} << 63},
+      {uint64_t{1}, uint64_t{1}},
+      {uint64_t{1} << 63, uint64_t{1}},
+      {0, uint64_t{1}},
+  };
+  BitMatrix bit_matrix(v);
+  ASSERT_EQ(bit_matrix.num_columns(), 128u);
+  // the columns in between have no rows
+  std::vector<std::size_t> rows;
+  ASSERT_FALSE(SolveCoverProblem(bit_matrix, rows));
+
+  BitMatrix::RowMask primary = {uint64_t{1} | (uint64_t{1} << 63),
+                                uint64_t{1} | (uint64_t{1} << 63)};
+  BitMatrix sparse_matrix(v, primary);
+  std::vector<std::vector<std::size_t>> solutions;
+  ExhaustiveSolveCoverProblem(sparse_matrix, solutions);
+  ASSERT_EQ(solutions.size(), 1u);
+  ASSERT_THAT(solutions[0], testing::UnorderedElementsAre(0, 3));
+}
+
+TEST(BitMatrix, ManyRows) {
+  // 300 rows so that the row bitsets span several __m256i
+  std::vector<uint64_t> v(298, 0b011);
+  v.push_back(0b100);
+  v.push_back(0b001);
+  BitMatrix bit_matrix(v);
+  std::vector<std::vector<std::size_t>> solutions;
+  ExhaustiveSolveCoverProblem(bit_matrix, solutions);
+  ASSERT_EQ(solutions.size(), 298u);
+  for (const auto &solution : solutions) {
+    ASSERT_THAT(solution, testing::Contains(298));
+  }
+}
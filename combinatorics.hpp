@@ -192,6 +192,7 @@ public:
     uint64_t num_dimensions{};
     for (const auto &seq : m_sequences) {
       m_indices.push_back(seq.end());
+      m_begins.push_back(seq.begin());
       num_dimensions += seq.num_dims();
       m_index *= seq.num_subsets();
     }
@@ -203,6 +204,7 @@ public:
     uint64_t num_dimensions{};
     for (const auto &seq : m_sequences) {
       m_indices.push_back(seq.begin());
+      m_begins.push_back(seq.begin());
       num_dimensions += seq.num_dims();
     }
     m_storage.resize(num_dimensions);
@@ -279,6 +281,9 @@ private:
   uint64_t m_index;
   std::vector<T> m_sequences;
   std::vector<std::decay_t<decltype(std::declval<T>().begin())>> m_indices;
+  // begin() of every sequence, copied into m_indices when it wraps around
+  // instead of creating a new iterator, which allocates
+  std::vector<std::decay_t<decltype(std::declval<T>().begin())>> m_begins;
   std::vector<uint64_t> m_storage;
 
   void update_storage() {
@@ -290,10 +295,12 @@ private:
   void inc() {
     ++m_index;
     for (int i = 0; i < m_sequences.size(); ++i) {
-      if (++m_indices[i] != m_sequences[i].end()) {
+      // compared by position, end() would create an iterator
+      if (++m_indices[i] - m_begins[i] !=
+          static_cast<difference_type>(m_sequences[i].num_subsets())) {
         return;
       }
-      m_indices[i] = m_sequences[i].begin();
+      m_indices[i] = m_begins[i];
     }
   }
   void dec() {
@@ -0,0 +1,195 @@
+#include "configuration_filter.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+// +1 or -1 for the cell at (x, y) in colouring c, relative to the top left
+// corner of the board
+int Colour(std::size_t c, int x, int y) {
+  const int bit = c == 0 ? (x + y) & 1 : c == 1 ? x & 1 : y & 1;
+  return bit ? -1 : 1;
+}
+} // namespace
+
+const char *ConfigurationFilter::RuleName(Rule rule) {
+  switch (rule) {
+  case Rule::AREA:
+    return "area";
+  case Rule::COVERAGE:
+    return "coverage";
+  case Rule::CHECKERBOARD:
+    return "checkerboard";
+  case Rule::COLUMN_STRIPES:
+    return "column stripes";
+  case Rule::ROW_STRIPES:
+    return "row stripes";
+  case Rule::ROW_CAPACITY:
+    return "row capacity";
+  case Rule::COLUMN_CAPACITY:
+    return "column capacity";
+  }
+  return "unknown";
+}
+
+uint64_t ConfigurationFilter::Stats::total_rejected() const {
+  uint64_t result = 0;
+  for (const auto count : rejected) {
+    result += count;
+  }
+  return result;
+}
+
+void ConfigurationFilter::Stats::Merge(const Stats &other) {
+  checked += other.checked;
+  for (std::size_t rule = 0; rule < kNumRules; ++rule) {
+    rejected[rule] += other.rejected[rule];
+  }
+}
+
+ConfigurationFilter::ConfigurationFilter(const PuzzleParams &params)
+    : params(params) {
+  int x_min = params.cells[0].first;
+  int y_min = params.cells[0].second;
+  int x_max = x_min;
+  int y_max = y_min;
+  for (const auto &[x, y] : params.cells) {
+    x_min = std::min<int>(x_min, x);
+    y_min = std::min<int>(y_min, y);
+    x_max = std::max<int>(x_max, x);
+    y_max = std::max<int>(y_max, y);
+  }
+  // cell i is at (xs[i], ys[i]) relative to the top left corner
+  std::vector<int> xs;
+  std::vector<int> ys;
+  row_cells.resize(y_max - y_min + 1);
+  column_cells.resize(x_max - x_min + 1);
+  for (const auto &[x, y] : params.cells) {
+    xs.push_back(x - x_min);
+    ys.push_back(y - y_min);
+    ++row_cells[ys.back()];
+    ++column_cells[xs.back()];
+    for (std::size_t c = 0; c < kNumColourings; ++c) {
+      board_sums[c] += Colour(c, xs.back(), ys.back());
+    }
+  }
+  for (std::size_t size = 1; size <= kMaxPolyominoSize; ++size) {
+    for (std::size_t index = 0;
+         index < params.possible_tiles_per_size[size - 1].size(); ++index) {
+      TileInfo &tile = tiles[size - 1].emplace_back();
+      tile.row_cells.resize(row_cells.size());
+      tile.column_cells.resize(column_cells.size());
+      for (const auto mask : params[PolyominoSubsetIndex{size, index}]) {
+        tile.reach |= mask;
+        std::array<int, kNumColourings> sums{};
+        std::vector<uint8_t> rows(row_cells.size());
+        std::vector<uint8_t> columns(column_cells.size());
+        for (BitMaskType bits = mask; bits != 0; bits &= bits - 1) {
+          const std::size_t cell = std::countr_zero(bits);
+          for (std::size_t c = 0; c < kNumColourings; ++c) {
+            sums[c] += Colour(c, xs[cell], ys[cell]);
+          }
+          ++rows[ys[cell]];
+          ++columns[xs[cell]];
+        }
+        for (std::size_t c = 0; c < kNumColourings; ++c) {
+          tile.sums[c] |= uint32_t{1} << (sums[c] + kMaxPolyominoSize);
+        }
+        for (std::size_t r = 0; r < rows.size(); ++r) {
+          tile.row_cells[r] = std::max(tile.row_cells[r], rows[r]);
+        }
+        for (std::size_t col = 0; col < columns.size(); ++col) {
+          tile.column_cells[col] =
+              std::max(tile.column_cells[col], columns[col]);
+        }
+      }
+    }
+  }
+}
+
+bool ConfigurationFilter::Accept(
+    const std::vector<PolyominoSubsetIndex> &configuration) {
+  ++m_stats.checked;
+  if (const auto rule = Check(configuration)) {
+    ++m_stats.rejected[static_cast<std::size_t>(*rule)];
+    return false;
+  }
+  return true;
+}
+
+std::optional<ConfigurationFilter::Rule> ConfigurationFilter::Check(
+    const std::vector<PolyominoSubsetIndex> &configuration) const {
+  std::size_t area = 0;
+  for (const auto &tile : configuration) {
+    area += tile.N;
+  }
+  if (area > params.N) {
+    return Rule::AREA;
+  }
+  // cells that stay empty
+  const std::size_t slack = params.N - area;
+
+  BitMaskType reach = 0;
+  for (const auto &tile : configuration) {
+    reach |= info(tile).reach;
+  }
+  const BitMaskType board =
+      params.N == 64 ? ~BitMaskType{0} : (BitMaskType{1} << params.N) - 1;
+  if (static_cast<std::size_t>(std::popcount(board & ~reach)) > slack) {
+    return Rule::COVERAGE;
+  }
+
+  constexpr std::array<Rule, kNumColourings> kColouringRules = {
+      Rule::CHECKERBOARD, Rule::COLUMN_STRIPES, Rule::ROW_STRIPES};
+  for (std::size_t c = 0; c < kNumColourings; ++c) {
+    // sums the pieces can cover, shifted by kSumOffset
+    Sums sums;
+    sums.set(kSumOffset);
+    for (const auto &tile : configuration) {
+      Sums next;
+      for (uint32_t bits = info(tile).sums[c]; bits != 0; bits &= bits - 1) {
+        const int sum = std::countr_zero(bits) - int{kMaxPolyominoSize};
+        next |= sum >= 0 ? sums << sum : sums >> -sum;
+      }
+      sums = next;
+    }
+    // the empty cells make up the rest of the board sum, slack cells of
+    // colour +1 or -1
+    Sums allowed;
+    for (int empty_sum = -static_cast<int>(slack);
+         empty_sum <= static_cast<int>(slack); empty_sum += 2) {
+      const int covered_sum = board_sums[c] - empty_sum + kSumOffset;
+      if (covered_sum >= 0 && covered_sum < static_cast<int>(sums.size())) {
+        allowed.set(covered_sum);
+      }
+    }
+    if ((sums & allowed).none()) {
+      return kColouringRules[c];
+    }
+  }
+
+  const auto capacity_check = [&](const std::vector<uint8_t> &cells,
+                                  auto tile_cells) {
+    // a board has at most 64 rows or columns
+    std::array<std::size_t, 64> covered{};
+    for (const auto &tile : configuration) {
+      const std::vector<uint8_t> &most = info(tile).*tile_cells;
+      for (std::size_t i = 0; i < cells.size(); ++i) {
+        covered[i] += most[i];
+      }
+    }
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+      if (covered[i] + slack < cells[i]) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (!capacity_check(row_cells, &TileInfo::row_cells)) {
+    return Rule::ROW_CAPACITY;
+  }
+  if (!capacity_check(column_cells, &TileInfo::column_cells)) {
+    return Rule::COLUMN_CAPACITY;
+  }
+  return std::nullopt;
+}
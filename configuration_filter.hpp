@@ -0,0 +1,92 @@
+#pragma once
+#include "puzzle_solver.hpp"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Necessary conditions for a configuration to fit on the board, checked in a
+// few hundred nanoseconds before handing it to PuzzleSolver::Solve. Like
+// Solve it allows the pieces to leave cells empty, as many as the board has
+// more cells than the pieces. A configuration it rejects has no solution, one
+// it accepts may still have none.
+//
+// The rules, in the order they are checked:
+// - AREA: the pieces have no more cells than the board.
+// - COVERAGE: no more cells than may stay empty are out of reach of every
+//   placement of the pieces.
+// - CHECKERBOARD, COLUMN_STRIPES, ROW_STRIPES: colour the cells +1 and -1 in
+//   a checkerboard, by column or by row. Every placement of a piece covers
+//   cells of some colour sum, and the sums of one placement per piece plus
+//   that of the empty cells have to add up to the sum of the board.
+// - ROW_CAPACITY, COLUMN_CAPACITY: the pieces can cover as many cells of
+//   every row (column) as the row has, less the cells that may stay empty,
+//   taking for each piece its placement with the most cells in that row.
+class ConfigurationFilter {
+public:
+  enum class Rule {
+    AREA,
+    COVERAGE,
+    CHECKERBOARD,
+    COLUMN_STRIPES,
+    ROW_STRIPES,
+    ROW_CAPACITY,
+    COLUMN_CAPACITY,
+  };
+  static constexpr std::size_t kNumRules = 7;
+  static const char *RuleName(Rule rule);
+
+  struct Stats {
+    uint64_t checked = 0;
+    // rejected[rule]: configurations rule was the first to reject
+    std::array<uint64_t, kNumRules> rejected{};
+
+    uint64_t total_rejected() const;
+    void Merge(const Stats &other);
+  };
+
+  explicit ConfigurationFilter(const PuzzleParams &params);
+
+  // False if one of the rules shows that the configuration can't be placed,
+  // counted in stats() under the first rule that rejects it.
+  bool Accept(const std::vector<PolyominoSubsetIndex> &configuration);
+
+  const Stats &stats() const { return m_stats; }
+  void ClearStats() { m_stats = {}; }
+
+private:
+  static constexpr std::size_t kNumColourings = 3;
+  // Colour sums are offset by kSumOffset to be bit indices, the sums of up to
+  // kMaxPieces pieces and the empty cells lie in [-64, 64].
+  static constexpr int kSumOffset = 64;
+  using Sums = std::bitset<2 * kSumOffset + 1>;
+
+  struct TileInfo {
+    // cells covered by some placement of the piece
+    BitMaskType reach = 0;
+    // sums[c]: bit s + kMaxPolyominoSize set if a placement of the piece
+    // covers cells of colour sum s in colouring c
+    std::array<uint32_t, kNumColourings> sums{};
+    // the most cells of every row and column a placement covers
+    std::vector<uint8_t> row_cells;
+    std::vector<uint8_t> column_cells;
+  };
+
+  // the rule that rejects the configuration, if any
+  std::optional<Rule>
+  Check(const std::vector<PolyominoSubsetIndex> &configuration) const;
+  const TileInfo &info(PolyominoSubsetIndex tile) const {
+    return tiles[tile.N - 1][tile.index];
+  }
+
+  const PuzzleParams &params;
+  std::array<std::vector<TileInfo>, kMaxPolyominoSize> tiles;
+  // colour sum of the whole board for every colouring
+  std::array<int, kNumColourings> board_sums{};
+  // cells of every row and column
+  std::vector<uint8_t> row_cells;
+  std::vector<uint8_t> column_cells;
+  Stats m_stats;
+};
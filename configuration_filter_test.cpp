@@ -0,0 +1,81 @@
+#include "configuration_filter.hpp"
+#include "polyominos.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+
+TEST(ConfigurationFilter, MutilatedCheckerboard) {
+  // a 4x4 square less two opposite corners, which have the same colour
+  std::array<std::pair<int8_t, int8_t>, 14> coords;
+  std::size_t i = 0;
+  for (int8_t x = 0; x < 4; ++x) {
+    for (int8_t y = 0; y < 4; ++y) {
+      if ((x == 0 && y == 0) || (x == 3 && y == 3)) {
+        continue;
+      }
+      coords[i++] = {x, y};
+    }
+  }
+  const PuzzleParams params{Polyomino<14>{coords}};
+  ConfigurationFilter filter(params);
+  const std::vector<PolyominoSubsetIndex> dominos(7, {2, 0});
+  EXPECT_FALSE(filter.Accept(dominos));
+  EXPECT_EQ(filter.stats().rejected[static_cast<std::size_t>(
+                ConfigurationFilter::Rule::CHECKERBOARD)],
+            1u);
+
+  // with a hole left the dominos only have to miss one corner's colour
+  const std::vector<PolyominoSubsetIndex> fewer(6, {2, 0});
+  EXPECT_TRUE(filter.Accept(fewer));
+  const std::vector<PolyominoSubsetIndex> more(8, {2, 0});
+  EXPECT_FALSE(filter.Accept(more));
+  EXPECT_EQ(filter.stats().rejected[static_cast<std::size_t>(
+                ConfigurationFilter::Rule::AREA)],
+            1u);
+  EXPECT_EQ(filter.stats().checked, 3u);
+  EXPECT_EQ(filter.stats().total_rejected(), 2u);
+}
+
+TEST(ConfigurationFilter, NeverRejectsSolvable) {
+  const auto board = RemoveOne(CreateSquare<5>(), 7);
+  PuzzleParams params{board};
+  PuzzleSolver solver(params);
+  ConfigurationFilter filter(params);
+
+  std::mt19937 gen(45);
+  uint64_t solvable = 0;
+  for (int round = 0; round < 2000; ++round) {
+    // mostly configurations filling the board, with nothing left empty
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = round % 4 == 0 ? 1 : 0;
+    while (area < params.N) {
+      const std::size_t size =
+          std::min<std::size_t>(2 + gen() % 4, params.N - area);
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    const bool solved = solver.Solve(candidate_tiles, solution);
+    solvable += solved;
+    if (!filter.Accept(candidate_tiles)) {
+      EXPECT_FALSE(solved);
+    }
+  }
+  const auto &stats = filter.stats();
+  EXPECT_EQ(stats.checked, 2000u);
+  EXPECT_GT(solvable, 0u);
+  EXPECT_GT(stats.total_rejected(), 0u);
+  // the colourings reject configurations that fill the board
+  const auto rejected = [&](ConfigurationFilter::Rule rule) {
+    return stats.rejected[static_cast<std::size_t>(rule)];
+  };
+  EXPECT_GT(rejected(ConfigurationFilter::Rule::CHECKERBOARD), 0u);
+  EXPECT_GT(rejected(ConfigurationFilter::Rule::COLUMN_STRIPES) +
+                rejected(ConfigurationFilter::Rule::ROW_STRIPES),
+            0u);
+}
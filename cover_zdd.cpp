@@ -0,0 +1,87 @@
+#include "cover_zdd.hpp"
+
+#include <algorithm>
+
+CoverZdd::CoverZdd() {
+  // terminals, their row is never looked at
+  nodes.push_back(Node{0, kEmpty, kEmpty});
+  nodes.push_back(Node{0, kUnit, kUnit});
+  counts = {0, 1};
+}
+
+CoverZdd::NodeIndex CoverZdd::AddNode(std::size_t row, NodeIndex lo,
+                                      NodeIndex hi) {
+  if (hi == kEmpty) {
+    return lo;
+  }
+  const Node node{row, lo, hi};
+  const auto [it, inserted] =
+      unique_table.emplace(node, static_cast<NodeIndex>(nodes.size()));
+  if (inserted) {
+    nodes.push_back(node);
+  }
+  return it->second;
+}
+
+void CoverZdd::SetRoot(NodeIndex root) {
+  m_root = root;
+  counts.resize(nodes.size());
+  for (std::size_t idx = 2; idx < nodes.size(); ++idx) {
+    counts[idx] = counts[nodes[idx].lo] + counts[nodes[idx].hi];
+  }
+}
+
+std::vector<std::size_t>
+CoverZdd::SampleSolution(std::mt19937_64 &rng) const {
+  std::vector<std::size_t> result;
+  NodeIndex idx = m_root;
+  while (idx != kUnit && idx != kEmpty) {
+    const Node &node = nodes[idx];
+    std::uniform_int_distribution<uint64_t> dist(0, counts[idx] - 1);
+    if (dist(rng) < counts[node.hi]) {
+      result.push_back(node.row);
+      idx = node.hi;
+    } else {
+      idx = node.lo;
+    }
+  }
+  return result;
+}
+
+std::vector<uint64_t>
+CoverZdd::SolutionsPerRow(std::size_t num_rows) const {
+  std::vector<uint64_t> result(num_rows);
+  // paths[idx]: number of ways to get from the root to node idx
+  std::vector<uint64_t> paths(nodes.size());
+  paths[m_root] = 1;
+  for (std::size_t idx = nodes.size(); idx-- > 2;) {
+    const Node &node = nodes[idx];
+    if (paths[idx] == 0) {
+      continue;
+    }
+    paths[node.lo] += paths[idx];
+    paths[node.hi] += paths[idx];
+    if (node.row < num_rows) {
+      result[node.row] += paths[idx] * counts[node.hi];
+    }
+  }
+  return result;
+}
+
+std::vector<std::size_t> CoverZdd::ForcedRows() const {
+  std::vector<std::size_t> result;
+  if (CountSolutions() == 0) {
+    return result;
+  }
+  std::size_t num_rows = 0;
+  for (std::size_t idx = 2; idx < nodes.size(); ++idx) {
+    num_rows = std::max(num_rows, nodes[idx].row + 1);
+  }
+  const auto per_row = SolutionsPerRow(num_rows);
+  for (std::size_t row = 0; row < num_rows; ++row) {
+    if (per_row[row] == CountSolutions()) {
+      result.push_back(row);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Zero-suppressed decision diagram of a family of sets of rows, e.g. all
+// solutions of an exact cover problem. A node stands for
+// lo ∪ {{row} ∪ s : s ∈ hi}. Nodes are only ever added on top of existing
+// ones, so the node index is a topological order and every analysis is a
+// single pass over the nodes.
+class CoverZdd {
+public:
+  using NodeIndex = uint32_t;
+  static constexpr NodeIndex kEmpty = 0; // no set at all
+  static constexpr NodeIndex kUnit = 1;  // only the empty set
+
+  struct Node {
+    std::size_t row;
+    NodeIndex lo;
+    NodeIndex hi;
+  };
+
+  CoverZdd();
+
+  // Returns the node for (row, lo, hi), reusing an identical node if there is
+  // one. Nodes with hi == kEmpty are suppressed.
+  NodeIndex AddNode(std::size_t row, NodeIndex lo, NodeIndex hi);
+  // Fixes the root and computes the number of sets below every node.
+  void SetRoot(NodeIndex root);
+
+  NodeIndex root() const { return m_root; }
+  const Node &node(NodeIndex idx) const { return nodes[idx]; }
+  std::size_t size() const { return nodes.size(); }
+
+  uint64_t CountSolutions() const { return counts[m_root]; }
+  // Every solution is returned with probability 1 / CountSolutions().
+  std::vector<std::size_t> SampleSolution(std::mt19937_64 &rng) const;
+  // result[row] is the number of solutions containing row, for
+  // row < num_rows.
+  std::vector<uint64_t> SolutionsPerRow(std::size_t num_rows) const;
+  // rows contained in every solution, empty if there is no solution
+  std::vector<std::size_t> ForcedRows() const;
+
+private:
+  struct NodeHash {
+    std::size_t operator()(const Node &node) const noexcept {
+      return node.row * 0x9E3779B97F4A7C15ull ^
+             (uint64_t{node.lo} << 32 | node.hi) * 0xC2B2AE3D27D4EB4Full;
+    }
+  };
+  struct NodeEqual {
+    bool operator()(const Node &a, const Node &b) const noexcept {
+      return a.row == b.row && a.lo == b.lo && a.hi == b.hi;
+    }
+  };
+
+  std::vector<Node> nodes;
+  // counts[idx]: number of sets below node idx
+  std::vector<uint64_t> counts;
+  std::unordered_map<Node, NodeIndex, NodeHash, NodeEqual> unique_table;
+  NodeIndex m_root = kEmpty;
+};
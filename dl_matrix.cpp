@@ -2,16 +2,24 @@
 #include <algorithm>
 #include <array>
 #include <bitset>
-#include <chrono>
+#include <cassert>
 #include <cstddef>
-#include <iostream>
+#include <execution>
+#include <istream>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <ostream>
+#include <thread>
 #include <unordered_set>
 #include <utility>
 
 // v is a vector of bitmasks
-DLMatrix::DLMatrix(const std::vector<uint64_t> &v) {
+DLMatrix::DLMatrix(const std::vector<uint64_t> &v) : DLMatrix(v, {}) {}
+
+DLMatrix::DLMatrix(const std::vector<uint64_t> &v,
+                   const std::vector<std::size_t> &multiplicities) {
   const auto num_entries =
       std::transform_reduce(v.begin(), v.end(), 0u, std::plus<uint64_t>{},
                             [](auto x) { return std::popcount(x); });
@@ -25,6 +33,8 @@ DLMatrix::DLMatrix(const std::vector<uint64_t> &v) {
     col_headers[col_idx].left = col_idx == 0 ? num_columns : col_idx - 1;
     col_headers[col_idx].right = col_idx == num_columns ? 0 : col_idx + 1;
     col_headers[col_idx].col_size = 0;
+    col_headers[col_idx].multiplicity =
+        col_idx < multiplicities.size() ? multiplicities[col_idx] : 1;
     col_headers[col_idx].down = -1;
     col_headers[col_idx].up = -1;
   }
@@ -62,19 +72,165 @@ DLMatrix::DLMatrix(const std::vector<uint64_t> &v) {
         entries.push_back(entry);
       }
     }
+    row_entry.push_back(first_entry_in_row);
     if (first_entry_in_row != -1) {
       entries[first_entry_in_row].left = last_entry_in_row;
       entries[last_entry_in_row].right = first_entry_in_row;
     }
   }
+  for (std::size_t col_idx = 0; col_idx < num_columns; ++col_idx) {
+    if (col_headers[col_idx].multiplicity == 0) {
+      // none of its rows can be selected
+      CoverColumn(col_idx);
+    }
+  }
+}
+
+DLMatrix::DLMatrix(const std::vector<std::vector<ColumnIndex>> &rows,
+                   std::size_t num_columns, std::size_t num_active_columns)
+    : num_columns(num_columns), num_rows(rows.size()) {
+  assert(num_columns < std::numeric_limits<ColumnIndex>::max());
+  col_headers.resize(num_columns + 1);
+  for (std::size_t col_idx = 0; col_idx <= num_columns; ++col_idx) {
+    auto &col_header = col_headers[col_idx];
+    col_header.left = col_idx;
+    col_header.right = col_idx;
+    col_header.col_size = 0;
+    col_header.multiplicity = 1;
+    col_header.down = -1;
+    col_header.up = -1;
+  }
+  for (std::size_t col_idx = 0; col_idx < num_active_columns; ++col_idx) {
+    ActivateColumn(col_idx);
+  }
+  const std::size_t num_entries = std::transform_reduce(
+      rows.begin(), rows.end(), std::size_t{0}, std::plus<std::size_t>{},
+      [](const auto &row) { return row.size(); });
+  assert(num_entries < std::numeric_limits<PtrType>::max());
+  entries.reserve(num_entries);
+  for (std::size_t row = 0; row < rows.size(); ++row) {
+    const PtrType first_entry_in_row = rows[row].empty() ? -1 : entries.size();
+    for (const auto col_idx : rows[row]) {
+      const PtrType cur_index = entries.size();
+      entries.push_back(Entry{
+          .left = cur_index == first_entry_in_row ? PtrType{-1}
+                                                  : PtrType(cur_index - 1),
+          .right = PtrType(cur_index + 1),
+          .up = -1,
+          .down = -1,
+          .col = col_idx,
+          .row = static_cast<RowIndex>(row),
+      });
+    }
+    row_entry.push_back(first_entry_in_row);
+    if (first_entry_in_row != -1) {
+      entries[first_entry_in_row].left = entries.size() - 1;
+      entries.back().right = first_entry_in_row;
+    }
+  }
+}
+
+void DLMatrix::ActivateColumn(ColumnIndex col_idx, std::size_t multiplicity) {
+  const ColumnIndex root_idx = col_headers.size() - 1;
+  auto &col_header = col_headers[col_idx];
+  col_header.left = col_headers[root_idx].left;
+  col_header.right = root_idx;
+  col_header.multiplicity = multiplicity;
+  RestoreColumnHeader(col_idx);
+}
+
+void DLMatrix::DeactivateColumn(ColumnIndex col_idx) {
+  DetachColumnHeader(col_idx);
+}
+
+void DLMatrix::ActivateRow(RowIndex row) {
+  if (heuristic == Heuristic::MRV_BUCKETS) {
+    ActivateRow<true>(row);
+  } else {
+    ActivateRow<false>(row);
+  }
+}
+
+void DLMatrix::DeactivateRow(RowIndex row) {
+  if (heuristic == Heuristic::MRV_BUCKETS) {
+    DeactivateRow<true>(row);
+  } else {
+    DeactivateRow<false>(row);
+  }
+}
+
+template <bool kBuckets> void DLMatrix::ActivateRow(RowIndex row) {
+  const PtrType first = row_entry[row];
+  if (first == -1) {
+    return;
+  }
+  PtrType idx = first;
+  do {
+    // append to the bottom of the column
+    entries[idx].up = col_headers[entries[idx].col].up;
+    entries[idx].down = -1;
+    RestoreEntryFromColumn<kBuckets>(idx);
+    idx = entries[idx].right;
+  } while (idx != first);
+}
+
+template <bool kBuckets> void DLMatrix::DeactivateRow(RowIndex row) {
+  const PtrType first = row_entry[row];
+  if (first == -1) {
+    return;
+  }
+  DetachEntryFromColumn<kBuckets>(first);
+  WalkRowRight(first,
+               [this](PtrType idx) { DetachEntryFromColumn<kBuckets>(idx); });
 }
 
 const DLMatrix::ColHeader &DLMatrix::root() const { return col_headers.back(); }
 
+DLMatrix::ColumnIndex
+DLMatrix::ChooseColumnByHeuristic(std::size_t &col_size) {
+  switch (heuristic) {
+  case Heuristic::MRV:
+    return ChooseColumnByScan<false>(col_size);
+  case Heuristic::MRV_BUCKETS:
+    return ChooseColumnFromBuckets(col_size);
+  case Heuristic::PREFER_FIRST_COLUMNS:
+    return ChooseColumnPreferFirst(col_size);
+  case Heuristic::MRV_RANDOM_TIES:
+    return ChooseColumnByScan<true>(col_size);
+  }
+  return ChooseColumnByScan<false>(col_size);
+}
+
+void DLMatrix::SetHeuristic(Heuristic new_heuristic,
+                            std::size_t new_num_preferred_columns,
+                            uint64_t seed) {
+  heuristic = new_heuristic;
+  num_preferred_columns = new_num_preferred_columns;
+  rng.seed(seed);
+  bucket_heads.clear();
+  min_bucket = 0;
+  num_starved_columns = 0;
+  if (heuristic == Heuristic::MRV_BUCKETS) {
+    bucket_heads.assign(num_rows + 1, -1);
+    bucket_prev.assign(col_headers.size(), -1);
+    bucket_next.assign(col_headers.size(), -1);
+    min_bucket = bucket_heads.size();
+    // inserted from the right so that the leftmost column ends up first
+    const ColumnIndex root_idx = col_headers.size() - 1;
+    for (ColumnIndex idx = col_headers[root_idx].left; idx != root_idx;
+         idx = col_headers[idx].left) {
+      BucketInsert(idx);
+    }
+  }
+}
+
+template <bool kBuckets>
 void DLMatrix::DetachEntryFromColumn(PtrType entry_idx) {
-  // ++detach_entry_ops;
   const auto &entry = entries[entry_idx];
   auto &col_header = col_headers[entry.col];
+  if constexpr (kBuckets) {
+    BucketRemoveUnchecked(entry.col);
+  }
   if (entry.up == -1) {
     col_header.down = entry.down;
   } else {
@@ -86,12 +242,18 @@ void DLMatrix::DetachEntryFromColumn(PtrType entry_idx) {
     entries[entry.down].up = entry.up;
   }
   --col_header.col_size;
+  if constexpr (kBuckets) {
+    BucketInsertUnchecked(entry.col);
+  }
 }
 
+template <bool kBuckets>
 void DLMatrix::RestoreEntryFromColumn(PtrType entry_idx) {
-  // ++restore_entry_ops;
   const auto &entry = entries[entry_idx];
   auto &col_header = col_headers[entry.col];
+  if constexpr (kBuckets) {
+    BucketRemoveUnchecked(entry.col);
+  }
   if (entry.up == -1) {
     col_header.down = entry_idx;
   } else {
@@ -103,6 +265,9 @@ void DLMatrix::RestoreEntryFromColumn(PtrType entry_idx) {
     entries[entry.down].up = entry_idx;
   }
   ++col_header.col_size;
+  if constexpr (kBuckets) {
+    BucketInsertUnchecked(entry.col);
+  }
 }
 
 std::string DLMatrix::DebugString() const {
@@ -171,61 +336,57 @@ std::string DLMatrix::DebugString() const {
 }
 
 void DLMatrix::DetachColumnHeader(ColumnIndex col_idx) {
-  ++detach_column_ops;
+  BucketRemove(col_idx);
   col_headers[col_headers[col_idx].left].right = col_headers[col_idx].right;
   col_headers[col_headers[col_idx].right].left = col_headers[col_idx].left;
 }
 
 void DLMatrix::RestoreColumnHeader(ColumnIndex col_idx) {
-  ++restore_column_ops;
   col_headers[col_headers[col_idx].left].right = col_idx;
   col_headers[col_headers[col_idx].right].left = col_idx;
+  BucketInsert(col_idx);
 }
 
 void DLMatrix::CoverColumn(ColumnIndex col_idx) {
-  ++cover_column_ops;
+  if (heuristic == Heuristic::MRV_BUCKETS) {
+    CoverColumn<true>(col_idx);
+  } else {
+    CoverColumn<false>(col_idx);
+  }
+}
+
+void DLMatrix::UncoverColum(ColumnIndex col_idx) {
+  if (heuristic == Heuristic::MRV_BUCKETS) {
+    UncoverColum<true>(col_idx);
+  } else {
+    UncoverColum<false>(col_idx);
+  }
+}
+
+template <bool kBuckets> void DLMatrix::CoverColumn(ColumnIndex col_idx) {
   DetachColumnHeader(col_idx);
   WalkDownCol(col_idx, [this](PtrType elem) {
-    WalkRowRight(elem, [this](PtrType idx) { DetachEntryFromColumn(idx); });
+    WalkRowRight(elem,
+                 [this](PtrType idx) { DetachEntryFromColumn<kBuckets>(idx); });
   });
 }
 
-void DLMatrix::UncoverColum(ColumnIndex col_idx) {
-  ++uncover_column_ops;
+template <bool kBuckets> void DLMatrix::UncoverColum(ColumnIndex col_idx) {
   WalkUpCol(col_idx, [this](PtrType elem) {
-    WalkRowLeft(elem, [this](PtrType idx) { RestoreEntryFromColumn(idx); });
+    WalkRowLeft(elem,
+                [this](PtrType idx) { RestoreEntryFromColumn<kBuckets>(idx); });
   });
   RestoreColumnHeader(col_idx);
 }
 
-void DLMatrix::PrintStats() {
-  auto last_tp = std::exchange(start_time, std::chrono::system_clock::now());
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-      start_time - last_tp);
-
-  std::cout << "Matrix is " << num_rows << "x" << num_columns << "\n";
-  std::cout << "with " << entries.size() << " entries\n";
-  std::cout << "number_of_times_stuck: " << number_of_times_stuck << std::endl;
-  if (duration.count() > 0) {
-    std::cout << "detach_entry_ops / ms: "
-              << detach_entry_ops / duration.count() << "\n"
-              << "restore_entry_ops / ms: "
-              << restore_entry_ops / duration.count() << "\n"
-              << "detach_column_ops / ms: "
-              << detach_column_ops / duration.count() << "\n"
-              << "restore_column_ops / ms: "
-              << restore_column_ops / duration.count() << "\n"
-              << "cover_column_ops / ms: "
-              << cover_column_ops / duration.count() << "\n"
-              << "uncover_column_ops / ms: "
-              << uncover_column_ops / duration.count() << std::endl;
-  }
-  detach_entry_ops = 0;
-  restore_entry_ops = 0;
-  detach_column_ops = 0;
-  restore_column_ops = 0;
-  cover_column_ops = 0;
-  uncover_column_ops = 0;
+void DLMatrix::SelectRow(PtrType elem) {
+  CoverColumn(entries[elem].col);
+  WalkRowRight(elem, [this](PtrType idx) { UseColumn(entries[idx].col); });
+}
+
+void DLMatrix::UnselectRow(PtrType elem) {
+  WalkRowLeft(elem, [this](PtrType idx) { UnuseColumn(entries[idx].col); });
+  UncoverColum(entries[elem].col);
 }
 
 bool SolveCoverProblem(DLMatrix& dl_matrix,
@@ -253,6 +414,11 @@ void ExhaustiveSolveCoverProblem(
     const std::vector<uint64_t> &v,
     std::vector<std::vector<std::size_t>> &solutions) {
   DLMatrix dl_matrix(v);
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+}
+
+void ExhaustiveSolveCoverProblem(
+    DLMatrix &dl_matrix, std::vector<std::vector<std::size_t>> &solutions) {
   std::vector<std::size_t> solution;
   dl_matrix.Recurse(
       [&]() {
@@ -263,3 +429,396 @@ void ExhaustiveSolveCoverProblem(
       [&](std::size_t row) { solution.push_back(row); },
       [&]() { solution.pop_back(); });
 }
+
+std::size_t
+SolveCoverProblem(DLMatrix &dl_matrix, std::size_t max_solutions,
+                  std::vector<std::vector<std::size_t>> &solutions) {
+  if (max_solutions == 0) {
+    return 0;
+  }
+  std::size_t found = 0;
+  std::vector<std::size_t> solution;
+  dl_matrix.Recurse(
+      [&]() {
+        solutions.push_back(solution);
+        return ++found < max_solutions;
+      },
+      [](DLMatrix::ColumnIndex) {},
+      [&](std::size_t row) { solution.push_back(row); },
+      [&]() { solution.pop_back(); });
+  return found;
+}
+
+DLMatrix::ColumnMask DLMatrix::UncoveredColumns() const {
+  ColumnMask result = {};
+  WalkAllCols([&](ColumnIndex col) {
+    result[col / 64] |= uint64_t{1} << (col % 64);
+  });
+  return result;
+}
+
+uint64_t DLMatrix::CountRecurse(
+    ColumnMask uncovered,
+    std::unordered_map<ColumnMask, uint64_t, ColumnMaskHash> &memo) {
+  const ColumnIndex root_idx = col_headers.size() - 1;
+  if (root().right == root_idx) {
+    return 1;
+  }
+  if (const auto it = memo.find(uncovered); it != memo.end()) {
+    return it->second;
+  }
+  SearchStats::NodeScope node(search_stats);
+  std::size_t min_col_size;
+  const ColumnIndex min_col = ChooseColumn(min_col_size);
+  uint64_t count = 0;
+  if (min_col_size == 0) {
+    search_stats.DeadEnd(min_col);
+  } else {
+    search_stats.AddChildren(min_col_size);
+    CoverColumn(min_col);
+    WalkDownCol(min_col, [&](PtrType elem) {
+      ColumnMask next = uncovered;
+      next[min_col / 64] &= ~(uint64_t{1} << (min_col % 64));
+      WalkRowRight(elem, [&](PtrType idx) {
+        const auto col = entries[idx].col;
+        next[col / 64] &= ~(uint64_t{1} << (col % 64));
+        CoverColumn(col);
+      });
+      count += CountRecurse(next, memo);
+      WalkRowLeft(elem, [&](PtrType idx) { UncoverColum(entries[idx].col); });
+    });
+    UncoverColum(min_col);
+  }
+  memo.emplace(uncovered, count);
+  return count;
+}
+
+uint64_t CountCoverSolutions(DLMatrix &dl_matrix) {
+  // the memo keys are masks of up to 128 columns that only tell whether a
+  // column is covered, not how often
+  assert(dl_matrix.col_headers.size() <= 129);
+  assert(std::all_of(dl_matrix.col_headers.begin(),
+                     dl_matrix.col_headers.end(),
+                     [](const auto &col) { return col.multiplicity <= 1; }));
+  std::unordered_map<DLMatrix::ColumnMask, uint64_t, DLMatrix::ColumnMaskHash>
+      memo;
+  return dl_matrix.CountRecurse(dl_matrix.UncoveredColumns(), memo);
+}
+
+uint64_t CountCoverSolutions(const std::vector<uint64_t> &v) {
+  DLMatrix dl_matrix(v);
+  return CountCoverSolutions(dl_matrix);
+}
+
+CoverZdd::NodeIndex DLMatrix::ZddRecurse(
+    ColumnMask uncovered, CoverZdd &zdd,
+    std::unordered_map<ColumnMask, CoverZdd::NodeIndex, ColumnMaskHash>
+        &memo) {
+  const ColumnIndex root_idx = col_headers.size() - 1;
+  if (root().right == root_idx) {
+    return CoverZdd::kUnit;
+  }
+  if (const auto it = memo.find(uncovered); it != memo.end()) {
+    return it->second;
+  }
+  SearchStats::NodeScope node(search_stats);
+  std::size_t min_col_size;
+  const ColumnIndex min_col = ChooseColumn(min_col_size);
+  CoverZdd::NodeIndex result = CoverZdd::kEmpty;
+  if (min_col_size == 0) {
+    search_stats.DeadEnd(min_col);
+  } else {
+    search_stats.AddChildren(min_col_size);
+    CoverColumn(min_col);
+    // bottom up, so that the first row of the column ends up on top
+    WalkUpCol(min_col, [&](PtrType elem) {
+      ColumnMask next = uncovered;
+      next[min_col / 64] &= ~(uint64_t{1} << (min_col % 64));
+      WalkRowRight(elem, [&](PtrType idx) {
+        const auto col = entries[idx].col;
+        next[col / 64] &= ~(uint64_t{1} << (col % 64));
+        CoverColumn(col);
+      });
+      result =
+          zdd.AddNode(entries[elem].row, result, ZddRecurse(next, zdd, memo));
+      WalkRowLeft(elem, [&](PtrType idx) { UncoverColum(entries[idx].col); });
+    });
+    UncoverColum(min_col);
+  }
+  memo.emplace(uncovered, result);
+  return result;
+}
+
+CoverZdd BuildCoverZdd(DLMatrix &dl_matrix) {
+  // the memo keys are masks of up to 128 columns that only tell whether a
+  // column is covered, not how often
+  assert(dl_matrix.col_headers.size() <= 129);
+  assert(std::all_of(dl_matrix.col_headers.begin(),
+                     dl_matrix.col_headers.end(),
+                     [](const auto &col) { return col.multiplicity <= 1; }));
+  CoverZdd zdd;
+  std::unordered_map<DLMatrix::ColumnMask, CoverZdd::NodeIndex,
+                     DLMatrix::ColumnMaskHash>
+      memo;
+  zdd.SetRoot(dl_matrix.ZddRecurse(dl_matrix.UncoveredColumns(), zdd, memo));
+  return zdd;
+}
+
+CoverZdd BuildCoverZdd(const std::vector<uint64_t> &v) {
+  DLMatrix dl_matrix(v);
+  return BuildCoverZdd(dl_matrix);
+}
+
+// Splits the search tree of a DLMatrix into tasks. A task is the path of
+// entries tried from the root, it is replayed on a private copy of the matrix.
+// Nested std::for_each(std::execution::par) lets idle threads steal the
+// subtrees that are still waiting.
+class ParallelCoverSearch {
+public:
+  using OnSolution = std::function<void(const std::vector<std::size_t> &)>;
+
+  ParallelCoverSearch(const std::vector<uint64_t> &v,
+                      std::size_t tasks_per_thread, OnSolution on_solution = {})
+      : pristine(v),
+        target_tasks(tasks_per_thread *
+                     std::max(1u, std::thread::hardware_concurrency())),
+        on_solution(std::move(on_solution)) {}
+
+  // Appends the solutions below path to out in search order, or passes them
+  // to on_solution if out is null. tasks is the number of tasks at the depth
+  // of path.
+  void Search(const std::vector<DLMatrix::PtrType> &path, std::size_t tasks,
+              std::vector<std::vector<std::size_t>> *out) {
+    auto matrix = AcquireMatrix();
+    for (const auto elem : path) {
+      matrix->SelectRow(elem);
+    }
+    const DLMatrix::ColumnIndex root_idx = matrix->col_headers.size() - 1;
+    if (tasks >= target_tasks || matrix->root().right == root_idx) {
+      std::vector<std::size_t> solution;
+      for (const auto elem : path) {
+        solution.push_back(matrix->entries[elem].row);
+      }
+      matrix->Recurse(
+          [&]() {
+            if (out) {
+              out->push_back(solution);
+            } else {
+              on_solution(solution);
+            }
+            return true;
+          },
+          [](DLMatrix::ColumnIndex) {},
+          [&](std::size_t row) { solution.push_back(row); },
+          [&]() { solution.pop_back(); });
+      Unwind(*matrix, path);
+      ReleaseMatrix(std::move(matrix));
+      return;
+    }
+
+    std::size_t min_col_size;
+    const auto min_col = matrix->ChooseColumn(min_col_size);
+    std::vector<DLMatrix::PtrType> children;
+    if (min_col_size != 0) {
+      matrix->WalkDownCol(min_col, [&](DLMatrix::PtrType elem) {
+        children.push_back(elem);
+      });
+    }
+    Unwind(*matrix, path);
+    ReleaseMatrix(std::move(matrix));
+
+    std::vector<std::vector<std::vector<std::size_t>>> child_out(
+        out ? children.size() : 0);
+    std::vector<std::size_t> child_indices(children.size());
+    std::iota(child_indices.begin(), child_indices.end(), 0);
+    std::for_each(std::execution::par, child_indices.begin(),
+                  child_indices.end(), [&](std::size_t i) {
+                    std::vector<DLMatrix::PtrType> child_path = path;
+                    child_path.push_back(children[i]);
+                    Search(child_path, tasks * children.size(),
+                           out ? &child_out[i] : nullptr);
+                  });
+    for (auto &solutions : child_out) {
+      std::move(solutions.begin(), solutions.end(), std::back_inserter(*out));
+    }
+  }
+
+private:
+  std::unique_ptr<DLMatrix> AcquireMatrix() {
+    {
+      std::lock_guard lk(pool_mutex);
+      if (!pool.empty()) {
+        auto result = std::move(pool.back());
+        pool.pop_back();
+        return result;
+      }
+    }
+    return std::make_unique<DLMatrix>(pristine);
+  }
+
+  void ReleaseMatrix(std::unique_ptr<DLMatrix> matrix) {
+    std::lock_guard lk(pool_mutex);
+    pool.push_back(std::move(matrix));
+  }
+
+  static void Unwind(DLMatrix &matrix,
+                     const std::vector<DLMatrix::PtrType> &path) {
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      matrix.UnselectRow(*it);
+    }
+  }
+
+  const DLMatrix pristine;
+  const std::size_t target_tasks;
+  const OnSolution on_solution;
+  std::mutex pool_mutex;
+  std::vector<std::unique_ptr<DLMatrix>> pool;
+};
+
+void ParallelExhaustiveSolveCoverProblem(
+    const std::vector<uint64_t> &v,
+    std::vector<std::vector<std::size_t>> &solutions,
+    std::size_t tasks_per_thread) {
+  ParallelCoverSearch search(v, tasks_per_thread);
+  search.Search({}, 1, &solutions);
+}
+
+void ParallelVisitCoverSolutions(
+    const std::vector<uint64_t> &v,
+    const std::function<void(const std::vector<std::size_t> &)> &on_solution,
+    std::size_t tasks_per_thread) {
+  ParallelCoverSearch search(v, tasks_per_thread, on_solution);
+  search.Search({}, 1, nullptr);
+}
+
+IterativeCoverSearch::IterativeCoverSearch(const std::vector<uint64_t> &v,
+                                           OnSolution on_solution)
+    : IterativeCoverSearch(v, {}, std::move(on_solution)) {}
+
+IterativeCoverSearch::IterativeCoverSearch(
+    const std::vector<uint64_t> &v,
+    const std::vector<std::size_t> &multiplicities, OnSolution on_solution)
+    : matrix(v, multiplicities), on_solution(std::move(on_solution)) {}
+
+bool IterativeCoverSearch::Step(std::size_t budget) {
+  const DLMatrix::ColumnIndex root_idx = matrix.col_headers.size() - 1;
+  for (; budget > 0 && !finished && !suspended; --budget) {
+    ++steps;
+    if (descend) {
+      if (matrix.root().right == root_idx) {
+        ++solutions;
+        if (on_solution) {
+          on_solution(CurrentPath());
+        }
+        descend = false;
+        continue;
+      }
+      std::size_t col_size;
+      const DLMatrix::ColumnIndex col = matrix.ChooseColumn(col_size);
+      if (col_size == 0) {
+        matrix.search_stats.DeadEnd(col);
+        descend = false;
+        continue;
+      }
+      const DLMatrix::PtrType elem = matrix.col_headers[col].down;
+      matrix.SelectRow(elem);
+      path.push_back(elem);
+      continue;
+    }
+    if (path.empty()) {
+      finished = true;
+      break;
+    }
+    const DLMatrix::PtrType elem = path.back();
+    matrix.UnselectRow(elem);
+    const DLMatrix::PtrType next = matrix.entries[elem].down;
+    if (next == -1) {
+      path.pop_back();
+    } else {
+      matrix.SelectRow(next);
+      path.back() = next;
+      descend = true;
+    }
+  }
+  return !finished;
+}
+
+std::vector<std::size_t> IterativeCoverSearch::CurrentPath() const {
+  std::vector<std::size_t> result;
+  result.reserve(path.size());
+  for (const auto elem : path) {
+    result.push_back(matrix.entries[elem].row);
+  }
+  return result;
+}
+
+void IterativeCoverSearch::SaveCheckpoint(std::ostream &out) const {
+  out << "dlx-checkpoint 1\n"
+      << matrix.num_rows << " " << matrix.num_columns << " "
+      << matrix.entries.size() << "\n"
+      << descend << " " << finished << " " << steps << " " << solutions
+      << "\n"
+      << path.size();
+  for (const auto row : CurrentPath()) {
+    out << " " << row;
+  }
+  out << "\n";
+}
+
+bool IterativeCoverSearch::LoadCheckpoint(std::istream &in) {
+  Unwind();
+  std::string magic;
+  int version = 0;
+  uint64_t num_rows = 0, num_columns = 0, num_entries = 0;
+  bool new_descend = true, new_finished = false;
+  uint64_t new_steps = 0, new_solutions = 0;
+  std::size_t depth = 0;
+  in >> magic >> version >> num_rows >> num_columns >> num_entries >>
+      new_descend >> new_finished >> new_steps >> new_solutions >> depth;
+  if (!in || magic != "dlx-checkpoint" || version != 1 ||
+      num_rows != matrix.num_rows || num_columns != matrix.num_columns ||
+      num_entries != matrix.entries.size()) {
+    return false;
+  }
+  // The column chosen at every level only depends on the rows above it, so
+  // the branch is replayed by finding each row in the column the search would
+  // branch on.
+  for (std::size_t level = 0; level < depth; ++level) {
+    std::size_t row = 0;
+    in >> row;
+    std::size_t col_size;
+    const DLMatrix::ColumnIndex col = matrix.ChooseColumn(col_size);
+    DLMatrix::PtrType found = -1;
+    if (in && col_size != 0) {
+      matrix.WalkDownCol(col, [&](DLMatrix::PtrType elem) {
+        if (static_cast<std::size_t>(matrix.entries[elem].row) == row) {
+          found = elem;
+          return false;
+        }
+        return true;
+      });
+    }
+    if (found == -1) {
+      Unwind();
+      return false;
+    }
+    matrix.SelectRow(found);
+    path.push_back(found);
+  }
+  descend = new_descend;
+  finished = new_finished;
+  steps = new_steps;
+  solutions = new_solutions;
+  return true;
+}
+
+void IterativeCoverSearch::Unwind() {
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    matrix.UnselectRow(*it);
+  }
+  path.clear();
+  descend = true;
+  finished = false;
+  steps = 0;
+  solutions = 0;
+}
@@ -1,20 +1,57 @@
 #pragma once
 
-#include <chrono>
+#include "cover_zdd.hpp"
+#include "search_stats.hpp"
+
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <iosfwd>
 #include <string>
 #include <sys/types.h>
+#include <unordered_map>
 #include <vector>
 #include <limits>
+#include <random>
 
 class DLMatrix {
 public:
-  using PtrType = int16_t; // -1 means nullptr
+  using PtrType = int32_t; // -1 means nullptr
   using ColumnIndex = int16_t;
-  using RowIndex = int16_t;
+  using RowIndex = int32_t;
+  // bit i is set if column i is uncovered, only for matrices with at most
+  // 128 columns
+  using ColumnMask = std::array<uint64_t, 2>;
+  struct ColumnMaskHash {
+    std::size_t operator()(const ColumnMask &mask) const noexcept {
+      return mask[0] * 0x9E3779B97F4A7C15ull ^ mask[1] * 0xC2B2AE3D27D4EB4Full;
+    }
+  };
 
   // v is a vector of bitmasks
   explicit DLMatrix(const std::vector<uint64_t> &v);
+  // Column col has to be covered by exactly multiplicities[col] rows, 1 for
+  // columns past the end of multiplicities (Knuth's Algorithm M with bounds
+  // [k, k]). Columns with a multiplicity above 1 are never branched on, so
+  // every row needs at least one column with multiplicity 1.
+  DLMatrix(const std::vector<uint64_t> &v,
+           const std::vector<std::size_t> &multiplicities);
+  // Matrix with the rows given as lists of columns, for matrices with more
+  // than 64 columns. No row is active and only the first num_active_columns
+  // columns are, the others are switched on with ActivateColumn and the rows
+  // with ActivateRow. This way one matrix can hold the rows of many problems
+  // that share the first columns.
+  DLMatrix(const std::vector<std::vector<ColumnIndex>> &rows,
+           std::size_t num_columns, std::size_t num_active_columns);
+
+  // Deactivate has to undo the Activate calls in reverse order, and neither
+  // may be called during a search. col has to be covered by exactly
+  // multiplicity > 0 rows.
+  void ActivateColumn(ColumnIndex col_idx, std::size_t multiplicity = 1);
+  void DeactivateColumn(ColumnIndex col_idx);
+  void ActivateRow(RowIndex row);
+  void DeactivateRow(RowIndex row);
 
   void CoverColumn(ColumnIndex col_idx);
   void UncoverColum(ColumnIndex col_idx);
@@ -47,7 +84,29 @@ public:
     PtrType up;
 
     std::size_t col_size;
+    // number of rows still to be selected in this column
+    std::size_t multiplicity;
+  };
+
+  // How ChooseColumn picks the column to branch on. All of them only branch
+  // on columns with multiplicity 1 and detect dead ends right away.
+  enum class Heuristic {
+    // fewest rows, the leftmost of those, by scanning all columns
+    MRV,
+    // fewest rows, found in buckets of columns by size that are kept up to
+    // date while entries are detached and restored
+    MRV_BUCKETS,
+    // fewest rows among the first num_preferred_columns columns (e.g. board
+    // cells before piece columns), the other columns only once those are
+    // covered
+    PREFER_FIRST_COLUMNS,
+    // fewest rows, uniformly random among the columns with that size
+    MRV_RANDOM_TIES,
   };
+  // Random ties make the search order depend on the seed, so checkpoints of
+  // IterativeCoverSearch can't be replayed with it.
+  void SetHeuristic(Heuristic heuristic, std::size_t num_preferred_columns = 0,
+                    uint64_t seed = 0);
 
   enum class Status {
     OK,
@@ -62,7 +121,19 @@ public:
 
   const ColHeader &root() const;
 
-  void PrintStats();
+  // Called at every node of Recurse that isn't a solution yet, the search
+  // backtracks if it returns false. Lets callers prune with knowledge the
+  // matrix doesn't have.
+  void SetPruneHook(std::function<bool()> hook) { prune_hook = std::move(hook); }
+
+  template <typename Visitor> void VisitActiveColumns(Visitor &&visitor) const {
+    WalkAllCols([&, this](ColumnIndex col) { visitor(col, col_headers[col]); });
+  }
+
+  // statistics of the searches on this matrix, empty unless built with
+  // USE_SEARCH_STATS
+  const SearchStats &stats() const { return search_stats; }
+  void ClearStats() { search_stats.Clear(); }
 private:
   
   template <typename Visitor> void WalkAllCols(Visitor &&visitor) const {
@@ -108,46 +179,236 @@ private:
     }
   }
 
+  // Covers all columns of the row of elem, the column of elem first. This is
+  // the step Recurse takes when it tries elem.
+  void SelectRow(PtrType elem);
+  void UnselectRow(PtrType elem);
+
+  // Column to branch on, picked by the heuristic among the active columns
+  // with multiplicity 1. col_size is 0 if the current partial solution is
+  // stuck.
+  ColumnIndex ChooseColumn(std::size_t &col_size) {
+    if (heuristic == Heuristic::MRV) [[likely]] {
+      return ChooseColumnByScan<false>(col_size);
+    }
+    return ChooseColumnByHeuristic(col_size);
+  }
+  // the other heuristics, out of line to keep the search loop small
+  ColumnIndex ChooseColumnByHeuristic(std::size_t &col_size);
+
+  template <bool kRandomTies>
+  ColumnIndex ChooseColumnByScan(std::size_t &col_size) {
+    const ColumnIndex root_idx = col_headers.size() - 1;
+    ColumnIndex min_col = root_idx;
+    std::size_t num_ties = 0;
+    col_size = std::numeric_limits<std::size_t>::max();
+    for (ColumnIndex idx = col_headers[root_idx].right; idx != root_idx;
+         idx = col_headers[idx].right) {
+      const auto &header = col_headers[idx];
+      if (header.multiplicity > 1) {
+        if (header.col_size < header.multiplicity) {
+          col_size = 0;
+          return idx;
+        }
+        continue;
+      }
+      if (header.col_size < col_size) {
+        col_size = header.col_size;
+        min_col = idx;
+        num_ties = 1;
+        if (col_size == 0) {
+          break;
+        }
+      } else if (kRandomTies && header.col_size == col_size &&
+                 std::uniform_int_distribution<std::size_t>(0, num_ties++)(
+                     rng) == 0) {
+        min_col = idx;
+      }
+    }
+    if (min_col == root_idx) {
+      // only columns with multiplicity above 1 are left
+      col_size = 0;
+    }
+    return min_col;
+  }
+
+  ColumnIndex ChooseColumnFromBuckets(std::size_t &col_size) {
+    const ColumnIndex root_idx = col_headers.size() - 1;
+    if (num_starved_columns > 0) {
+      col_size = 0;
+      return root_idx;
+    }
+    while (min_bucket < bucket_heads.size() &&
+           bucket_heads[min_bucket] == -1) {
+      ++min_bucket;
+    }
+    if (min_bucket == bucket_heads.size()) {
+      // only columns with multiplicity above 1 are left
+      col_size = 0;
+      return root_idx;
+    }
+    col_size = min_bucket;
+    return bucket_heads[min_bucket];
+  }
+
+  ColumnIndex ChooseColumnPreferFirst(std::size_t &col_size) {
+    const ColumnIndex root_idx = col_headers.size() - 1;
+    ColumnIndex min_col = root_idx;
+    ColumnIndex min_other_col = root_idx;
+    std::size_t min_other_col_size = std::numeric_limits<std::size_t>::max();
+    col_size = std::numeric_limits<std::size_t>::max();
+    for (ColumnIndex idx = col_headers[root_idx].right; idx != root_idx;
+         idx = col_headers[idx].right) {
+      const auto &header = col_headers[idx];
+      if (header.multiplicity > 1) {
+        if (header.col_size < header.multiplicity) {
+          col_size = 0;
+          return idx;
+        }
+        continue;
+      }
+      if (header.col_size == 0) {
+        col_size = 0;
+        return idx;
+      }
+      if (static_cast<std::size_t>(idx) < num_preferred_columns) {
+        if (header.col_size < col_size) {
+          col_size = header.col_size;
+          min_col = idx;
+        }
+      } else if (header.col_size < min_other_col_size) {
+        min_other_col_size = header.col_size;
+        min_other_col = idx;
+      }
+    }
+    if (min_col == root_idx) {
+      min_col = min_other_col;
+      col_size = min_other_col == root_idx ? 0 : min_other_col_size;
+    }
+    return min_col;
+  }
+
+  // Counts a selected row towards col, covers col once it has all its rows.
+  void UseColumn(ColumnIndex col_idx) {
+    auto &header = col_headers[col_idx];
+    if (header.multiplicity == 1) {
+      CoverColumn(col_idx);
+      header.multiplicity = 0;
+      return;
+    }
+    if (heuristic == Heuristic::MRV_BUCKETS) [[unlikely]] {
+      BucketRemoveUnchecked(col_idx);
+      --header.multiplicity;
+      BucketInsertUnchecked(col_idx);
+    } else {
+      --header.multiplicity;
+    }
+  }
+  void UnuseColumn(ColumnIndex col_idx) {
+    auto &header = col_headers[col_idx];
+    if (header.multiplicity == 0) {
+      header.multiplicity = 1;
+      UncoverColum(col_idx);
+      return;
+    }
+    if (heuristic == Heuristic::MRV_BUCKETS) [[unlikely]] {
+      BucketRemoveUnchecked(col_idx);
+      ++header.multiplicity;
+      BucketInsertUnchecked(col_idx);
+    } else {
+      ++header.multiplicity;
+    }
+  }
+
+  // Take an active column out of / put it into the bucket of its size, or the
+  // count of starved columns if it has multiplicity above 1. Inactive columns
+  // never change size, so they are not tracked.
+  void BucketRemove(ColumnIndex col_idx) {
+    if (heuristic == Heuristic::MRV_BUCKETS) {
+      BucketRemoveUnchecked(col_idx);
+    }
+  }
+  void BucketInsert(ColumnIndex col_idx) {
+    if (heuristic == Heuristic::MRV_BUCKETS) {
+      BucketInsertUnchecked(col_idx);
+    }
+  }
+  void BucketRemoveUnchecked(ColumnIndex col_idx) {
+    const auto &header = col_headers[col_idx];
+    if (header.multiplicity > 1) {
+      num_starved_columns -= header.col_size < header.multiplicity;
+      return;
+    }
+    const ColumnIndex prev = bucket_prev[col_idx];
+    const ColumnIndex next = bucket_next[col_idx];
+    if (prev == -1) {
+      bucket_heads[header.col_size] = next;
+    } else {
+      bucket_next[prev] = next;
+    }
+    if (next != -1) {
+      bucket_prev[next] = prev;
+    }
+  }
+  void BucketInsertUnchecked(ColumnIndex col_idx) {
+    const auto &header = col_headers[col_idx];
+    if (header.multiplicity > 1) {
+      num_starved_columns += header.col_size < header.multiplicity;
+      return;
+    }
+    const ColumnIndex next = bucket_heads[header.col_size];
+    bucket_prev[col_idx] = -1;
+    bucket_next[col_idx] = next;
+    if (next != -1) {
+      bucket_prev[next] = col_idx;
+    }
+    bucket_heads[header.col_size] = col_idx;
+    min_bucket = std::min(min_bucket, header.col_size);
+  }
+
   void DetachColumnHeader(ColumnIndex col_idx);
   void RestoreColumnHeader(ColumnIndex col_idx);
 
-  void DetachEntryFromColumn(PtrType entry_idx);
-  void RestoreEntryFromColumn(PtrType entry_idx);  
+  // kBuckets: keep the buckets of Heuristic::MRV_BUCKETS up to date. Chosen
+  // once per cover instead of per entry, it is the hottest code of the search.
+  template <bool kBuckets> void DetachEntryFromColumn(PtrType entry_idx);
+  template <bool kBuckets> void RestoreEntryFromColumn(PtrType entry_idx);
+  template <bool kBuckets> void ActivateRow(RowIndex row);
+  template <bool kBuckets> void DeactivateRow(RowIndex row);
+  template <bool kBuckets> void CoverColumn(ColumnIndex col_idx);
+  template <bool kBuckets> void UncoverColum(ColumnIndex col_idx);
   
   // return true if we should continue exploring
   template <typename ON_SOL, typename ON_STUCK, typename ON_TRY, typename ON_UNDO>
   bool Recurse(ON_SOL&& on_sol, ON_STUCK&& on_stuck, ON_TRY&& on_try, ON_UNDO&& on_undo) {
+    SearchStats::NodeScope node(search_stats);
     DLMatrix::ColumnIndex col = root().right;
     if (col == col_headers.size() - 1) {
       return on_sol();
     }
-    DLMatrix::ColumnIndex min_col = col_headers.size() - 1;
-    std::size_t min_col_size = std::numeric_limits<std::size_t>::max();
-    WalkAllCols([&](DLMatrix::ColumnIndex idx) {
-      if (col_headers[idx].col_size <
-          min_col_size) {
-        min_col_size = col_headers[idx].col_size;
-        min_col = idx;
-      }
-    });
-
+    if (prune_hook && !prune_hook()) {
+      return true;
+    }
+    std::size_t min_col_size;
+    const DLMatrix::ColumnIndex min_col = ChooseColumn(min_col_size);
     if (min_col_size == 0) {
-      ++number_of_times_stuck;
+      search_stats.DeadEnd(min_col);
       on_stuck(min_col);
       return true;
     }
+    search_stats.AddChildren(min_col_size);
     CoverColumn(min_col);
     bool keep_going = true;
     WalkDownCol(min_col, [&](DLMatrix::PtrType elem) {
       on_try( entries[elem].row );
       WalkRowRight(elem, [&](DLMatrix::PtrType idx) {
-        CoverColumn(entries[idx].col);
+        UseColumn(entries[idx].col);
       });
       keep_going = Recurse(on_sol, on_stuck, on_try, on_undo);
       on_undo();
       
       WalkRowLeft(elem, [&](DLMatrix::PtrType idx) {
-        UncoverColum(entries[idx].col);
+        UnuseColumn(entries[idx].col);
       });
       return keep_going;
     });
@@ -157,22 +418,51 @@ private:
 
   uint64_t num_columns{};
   uint64_t num_rows{};
+  // an entry of every row, -1 for empty rows
+  std::vector<PtrType> row_entry;
 
-  uint64_t detach_entry_ops{};
-  uint64_t restore_entry_ops{};
-  uint64_t detach_column_ops{};
-  uint64_t restore_column_ops{};
-  uint64_t cover_column_ops{};
-  uint64_t uncover_column_ops{};
-  uint64_t number_of_times_stuck{};
-  std::chrono::system_clock::time_point start_time = std::chrono::system_clock::now();
+  Heuristic heuristic = Heuristic::MRV;
+  std::size_t num_preferred_columns{};
+  std::mt19937_64 rng;
+  // bucket_heads[size]: first active column with multiplicity 1 and size
+  // rows, -1 if there is none
+  std::vector<ColumnIndex> bucket_heads;
+  // neighbours of a column in its bucket
+  std::vector<ColumnIndex> bucket_prev;
+  std::vector<ColumnIndex> bucket_next;
+  // no bucket below it is used
+  std::size_t min_bucket{};
+  // active columns with multiplicity above 1 and fewer rows than that
+  std::size_t num_starved_columns{};
+
+  SearchStats search_stats;
+  std::function<bool()> prune_hook;
+
+  ColumnMask UncoveredColumns() const;
+  uint64_t CountRecurse(
+      ColumnMask uncovered,
+      std::unordered_map<ColumnMask, uint64_t, ColumnMaskHash> &memo);
+
+  friend class ParallelCoverSearch;
+  friend class IterativeCoverSearch;
+
+  CoverZdd::NodeIndex ZddRecurse(
+      ColumnMask uncovered, CoverZdd &zdd,
+      std::unordered_map<ColumnMask, CoverZdd::NodeIndex, ColumnMaskHash>
+          &memo);
+
+  friend uint64_t CountCoverSolutions(DLMatrix &dl_matrix);
+  friend CoverZdd BuildCoverZdd(DLMatrix &dl_matrix);
 
   friend bool SolveCoverProblem(DLMatrix& dl_matrix,
                                 std::vector<std::size_t> &rows);
 
   friend void
-  ExhaustiveSolveCoverProblem(const std::vector<uint64_t> &v,
+  ExhaustiveSolveCoverProblem(DLMatrix &dl_matrix,
                               std::vector<std::vector<std::size_t>> &solutions);
+  friend std::size_t
+  SolveCoverProblem(DLMatrix &dl_matrix, std::size_t max_solutions,
+                    std::vector<std::vector<std::size_t>> &solutions);
 };
 
 bool SolveCoverProblem(DLMatrix& dl_matrix,
@@ -181,3 +471,91 @@ bool SolveCoverProblem(DLMatrix& dl_matrix,
 void ExhaustiveSolveCoverProblem(
     const std::vector<uint64_t> &v,
     std::vector<std::vector<std::size_t>> &solutions);
+void ExhaustiveSolveCoverProblem(
+    DLMatrix &dl_matrix, std::vector<std::vector<std::size_t>> &solutions);
+// Like ExhaustiveSolveCoverProblem, but the search stops once it found
+// max_solutions solutions. Returns the number of solutions it added.
+std::size_t
+SolveCoverProblem(DLMatrix &dl_matrix, std::size_t max_solutions,
+                  std::vector<std::vector<std::size_t>> &solutions);
+
+// Number of solutions, without storing them. The number of completions of a
+// partial solution only depends on the columns still uncovered, so it is
+// memoized on that set. The matrix must not have more than 128 columns, nor
+// columns with multiplicity above 1.
+uint64_t CountCoverSolutions(DLMatrix &dl_matrix);
+uint64_t CountCoverSolutions(const std::vector<uint64_t> &v);
+
+// ZDD of all solutions, built by a DLX search that shares the subproblems with
+// the same uncovered columns (Knuth's DXZ). The rows of the ZDD are the rows of
+// the matrix. The matrix must not have more than 128 columns, nor columns with
+// multiplicity above 1.
+CoverZdd BuildCoverZdd(DLMatrix &dl_matrix);
+CoverZdd BuildCoverZdd(const std::vector<uint64_t> &v);
+
+// Same result as ExhaustiveSolveCoverProblem, solutions in the same order, but
+// the search tree is split into tasks that run on all cores. Subtrees are split
+// further until there are about tasks_per_thread tasks per hardware thread.
+void ParallelExhaustiveSolveCoverProblem(
+    const std::vector<uint64_t> &v,
+    std::vector<std::vector<std::size_t>> &solutions,
+    std::size_t tasks_per_thread = 16);
+
+// Calls on_solution for every solution, possibly from several threads at the
+// same time and in no particular order.
+void ParallelVisitCoverSolutions(
+    const std::vector<uint64_t> &v,
+    const std::function<void(const std::vector<std::size_t> &)> &on_solution,
+    std::size_t tasks_per_thread = 16);
+
+// The search of ExhaustiveSolveCoverProblem with an explicit stack instead of
+// recursion, so that it can be run in slices, paused, and saved to a stream
+// and continued later (also by another process). Solutions are reported in the
+// same order as ExhaustiveSolveCoverProblem.
+class IterativeCoverSearch {
+public:
+  using OnSolution = std::function<void(const std::vector<std::size_t> &)>;
+
+  IterativeCoverSearch(const std::vector<uint64_t> &v, OnSolution on_solution);
+  IterativeCoverSearch(const std::vector<uint64_t> &v,
+                       const std::vector<std::size_t> &multiplicities,
+                       OnSolution on_solution);
+
+  // Runs at most budget steps, a step selects or unselects one row. Returns
+  // early when the search is suspended. Returns false once the whole search
+  // tree has been visited.
+  bool Step(std::size_t budget);
+  // Makes Step return after the current step, e.g. from on_solution or from
+  // another thread. Step does nothing until Resume is called.
+  void Suspend() { suspended = true; }
+  void Resume() { suspended = false; }
+  bool is_suspended() const { return suspended; }
+  bool done() const { return finished; }
+
+  uint64_t num_steps() const { return steps; }
+  uint64_t num_solutions() const { return solutions; }
+  // rows selected on the current branch, from the root down
+  std::vector<std::size_t> CurrentPath() const;
+
+  // The checkpoint is the current branch and the counters, loading it replays
+  // the branch. It has to be loaded into a search over the same matrix.
+  void SaveCheckpoint(std::ostream &out) const;
+  // Returns false and leaves the search at its root if the checkpoint does not
+  // fit the matrix.
+  bool LoadCheckpoint(std::istream &in);
+
+private:
+  DLMatrix matrix;
+  const OnSolution on_solution;
+  // entry selected on every level of the current branch
+  std::vector<DLMatrix::PtrType> path;
+  // true if the next step goes down from the end of path, false if it goes
+  // on with the next sibling
+  bool descend = true;
+  bool finished = false;
+  std::atomic<bool> suspended = false;
+  uint64_t steps{};
+  uint64_t solutions{};
+
+  void Unwind();
+};
@@ -1,11 +1,34 @@
+#include "cover_zdd.hpp"
 #include "dl_matrix.hpp"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <atomic>
 #include <iostream>
+#include <map>
 #include <numeric>
 #include <random>
+#include <sstream>
+
+namespace {
+// rows are the domino placements on a width x height board
+std::vector<uint64_t> DominoPlacements(int width, int height) {
+  std::vector<uint64_t> v;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const uint64_t cell = uint64_t{1} << (y * width + x);
+      if (x + 1 < width) {
+        v.push_back(cell | (cell << 1));
+      }
+      if (y + 1 < height) {
+        v.push_back(cell | (cell << width));
+      }
+    }
+  }
+  return v;
+}
+} // namespace
 
 TEST(DLMatrix, SingleEntry) {
   std::vector<uint64_t> v = {1};
@@ -156,3 +179,354 @@ TEST(DLMatrix, ExhaustiveSolveCoverProblemTricky) {
   ASSERT_EQ(results.size(), 1);
   ASSERT_THAT(results[0], testing::UnorderedElementsAre(1,3,5));
 }
+
+TEST(DLMatrix, SolveCoverProblemAtMost) {
+  const auto v = DominoPlacements(4, 6);
+  std::vector<std::vector<std::size_t>> expected;
+  ExhaustiveSolveCoverProblem(v, expected);
+  for (std::size_t max_solutions : {0, 1, 2, 100, 1000}) {
+    DLMatrix dl_matrix(v);
+    std::vector<std::vector<std::size_t>> results;
+    const std::size_t found =
+        SolveCoverProblem(dl_matrix, max_solutions, results);
+    EXPECT_EQ(found, std::min(max_solutions, expected.size()));
+    // the first solutions of the exhaustive search
+    ASSERT_EQ(results.size(), found);
+    EXPECT_TRUE(std::equal(results.begin(), results.end(), expected.begin()));
+  }
+}
+
+TEST(DLMatrix, ParallelExhaustiveSolveCoverProblem) {
+  const auto v = DominoPlacements(4, 6);
+  std::vector<std::vector<std::size_t>> expected;
+  ExhaustiveSolveCoverProblem(v, expected);
+  ASSERT_EQ(expected.size(), 281u);
+
+  for (std::size_t tasks_per_thread : {1, 16, 1000}) {
+    std::vector<std::vector<std::size_t>> results;
+    ParallelExhaustiveSolveCoverProblem(v, results, tasks_per_thread);
+    ASSERT_EQ(results, expected);
+  }
+}
+
+TEST(DLMatrix, ParallelVisitCoverSolutions) {
+  const auto v = DominoPlacements(4, 6);
+  std::atomic<uint64_t> num_solutions{0};
+  ParallelVisitCoverSolutions(
+      v, [&](const std::vector<std::size_t> &solution) {
+        ASSERT_EQ(solution.size(), 12u);
+        ++num_solutions;
+      });
+  ASSERT_EQ(num_solutions, 281u);
+}
+
+TEST(DLMatrix, ParallelExhaustiveSolveCoverProblemNoSolution) {
+  std::vector<uint64_t> v = {
+      0b100,
+      0b101,
+  };
+  std::vector<std::vector<std::size_t>> results;
+  ParallelExhaustiveSolveCoverProblem(v, results);
+  ASSERT_TRUE(results.empty());
+}
+
+TEST(DLMatrix, CountCoverSolutions) {
+  EXPECT_EQ(CountCoverSolutions(std::vector<uint64_t>{0b10, 0b11}), 1u);
+  EXPECT_EQ(CountCoverSolutions(std::vector<uint64_t>{0b100, 0b101}), 0u);
+  EXPECT_EQ(CountCoverSolutions(std::vector<uint64_t>{
+                0b1001001, 0b1001000, 0b0001101, 0b0010110, 0b0110011,
+                0b0100001}),
+            1u);
+  EXPECT_EQ(CountCoverSolutions(DominoPlacements(4, 6)), 281u);
+  // far too many solutions to enumerate one by one
+  EXPECT_EQ(CountCoverSolutions(DominoPlacements(8, 8)), 12988816u);
+}
+
+TEST(DLMatrix, MultiplicityColumn) {
+  // the four dominoes of a 2x4 board all cover column 8, so it has to be
+  // covered four times
+  std::vector<uint64_t> v = DominoPlacements(4, 2);
+  for (auto &row : v) {
+    row |= uint64_t{1} << 8;
+  }
+  std::vector<std::size_t> multiplicities(9, 1);
+  multiplicities[8] = 4;
+  DLMatrix dl_matrix(v, multiplicities);
+  std::vector<std::vector<std::size_t>> solutions;
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+  EXPECT_EQ(solutions.size(), 5u);
+  for (const auto &solution : solutions) {
+    EXPECT_EQ(solution.size(), 4u);
+  }
+}
+
+TEST(DLMatrix, MultiplicityColumnMixed) {
+  // one domino (column 3) and one monomino (column 4) on a 1x3 strip
+  std::vector<uint64_t> v = {0b01011, 0b01110, 0b10001, 0b10010, 0b10100};
+  DLMatrix dl_matrix(v, {1, 1, 1, 1, 1});
+  std::vector<std::vector<std::size_t>> solutions;
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+  EXPECT_EQ(solutions.size(), 2u);
+
+  // two monominoes can't fit next to the domino
+  DLMatrix dl_matrix2(v, {1, 1, 1, 1, 2});
+  std::vector<std::size_t> rows;
+  EXPECT_FALSE(SolveCoverProblem(dl_matrix2, rows));
+
+  // without the domino the strip needs three monominoes
+  DLMatrix dl_matrix3(v, {1, 1, 1, 0, 3});
+  solutions.clear();
+  ExhaustiveSolveCoverProblem(dl_matrix3, solutions);
+  ASSERT_EQ(solutions.size(), 1u);
+  EXPECT_THAT(solutions[0], ::testing::UnorderedElementsAre(2, 3, 4));
+}
+
+class DLMatrixHeuristicTest
+    : public ::testing::TestWithParam<DLMatrix::Heuristic> {};
+
+INSTANTIATE_TEST_SUITE_P(
+    Heuristics, DLMatrixHeuristicTest,
+    ::testing::Values(DLMatrix::Heuristic::MRV,
+                      DLMatrix::Heuristic::MRV_BUCKETS,
+                      DLMatrix::Heuristic::PREFER_FIRST_COLUMNS,
+                      DLMatrix::Heuristic::MRV_RANDOM_TIES));
+
+TEST_P(DLMatrixHeuristicTest, SameSolutions) {
+  const auto v = DominoPlacements(4, 6);
+  std::vector<std::vector<std::size_t>> expected;
+  ExhaustiveSolveCoverProblem(v, expected);
+  for (auto &solution : expected) {
+    std::sort(solution.begin(), solution.end());
+  }
+  std::sort(expected.begin(), expected.end());
+
+  DLMatrix dl_matrix(v);
+  dl_matrix.SetHeuristic(GetParam(), 12, 7);
+  std::vector<std::vector<std::size_t>> solutions;
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+  for (auto &solution : solutions) {
+    std::sort(solution.begin(), solution.end());
+  }
+  std::sort(solutions.begin(), solutions.end());
+  EXPECT_EQ(solutions, expected);
+  // the matrix is back in its initial state
+  solutions.clear();
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+  EXPECT_EQ(solutions.size(), expected.size());
+}
+
+TEST_P(DLMatrixHeuristicTest, MultiplicityColumn) {
+  std::vector<uint64_t> v = DominoPlacements(4, 2);
+  for (auto &row : v) {
+    row |= uint64_t{1} << 8;
+  }
+  std::vector<std::size_t> multiplicities(9, 1);
+  multiplicities[8] = 4;
+  DLMatrix dl_matrix(v, multiplicities);
+  dl_matrix.SetHeuristic(GetParam(), 8);
+  std::vector<std::vector<std::size_t>> solutions;
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+  EXPECT_EQ(solutions.size(), 5u);
+
+  multiplicities[8] = 3;
+  DLMatrix dl_matrix2(v, multiplicities);
+  dl_matrix2.SetHeuristic(GetParam(), 8);
+  std::vector<std::size_t> rows;
+  EXPECT_FALSE(SolveCoverProblem(dl_matrix2, rows));
+}
+
+TEST_P(DLMatrixHeuristicTest, ActivateRows) {
+  // 2x2 board, column 4 is the domino, column 5 the monomino
+  const std::vector<std::vector<DLMatrix::ColumnIndex>> rows = {
+      {0, 1, 4}, {2, 3, 4}, {0, 2, 4}, {1, 3, 4},
+      {0, 5},    {1, 5},    {2, 5},    {3, 5},
+  };
+  DLMatrix dl_matrix(rows, 6, 4);
+  dl_matrix.SetHeuristic(GetParam(), 4);
+  std::vector<std::vector<std::size_t>> solutions;
+
+  // two dominoes
+  dl_matrix.ActivateColumn(4, 2);
+  for (DLMatrix::RowIndex row = 0; row < 4; ++row) {
+    dl_matrix.ActivateRow(row);
+  }
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+  EXPECT_EQ(solutions.size(), 2u);
+  for (DLMatrix::RowIndex row = 4; row-- > 0;) {
+    dl_matrix.DeactivateRow(row);
+  }
+  dl_matrix.DeactivateColumn(4);
+
+  // one domino and two monominoes
+  dl_matrix.ActivateColumn(4, 1);
+  dl_matrix.ActivateColumn(5, 2);
+  for (DLMatrix::RowIndex row = 0; row < 8; ++row) {
+    dl_matrix.ActivateRow(row);
+  }
+  solutions.clear();
+  ExhaustiveSolveCoverProblem(dl_matrix, solutions);
+  EXPECT_EQ(solutions.size(), 4u);
+  for (DLMatrix::RowIndex row = 8; row-- > 0;) {
+    dl_matrix.DeactivateRow(row);
+  }
+  dl_matrix.DeactivateColumn(5);
+  dl_matrix.DeactivateColumn(4);
+
+  // nothing to cover the cells with
+  std::vector<std::size_t> solution;
+  EXPECT_FALSE(SolveCoverProblem(dl_matrix, solution));
+}
+
+TEST(IterativeCoverSearch, SameSolutionsAsRecursiveSearch) {
+  const auto v = DominoPlacements(4, 6);
+  std::vector<std::vector<std::size_t>> expected;
+  ExhaustiveSolveCoverProblem(v, expected);
+
+  std::vector<std::vector<std::size_t>> solutions;
+  IterativeCoverSearch search(
+      v, [&](const auto &solution) { solutions.push_back(solution); });
+  while (search.Step(7)) {
+  }
+  EXPECT_TRUE(search.done());
+  EXPECT_EQ(search.num_solutions(), 281u);
+  EXPECT_EQ(solutions, expected);
+  EXPECT_TRUE(search.CurrentPath().empty());
+  EXPECT_FALSE(search.Step(1));
+}
+
+TEST(IterativeCoverSearch, SuspendAndResume) {
+  std::vector<std::vector<std::size_t>> solutions;
+  IterativeCoverSearch *search_ptr = nullptr;
+  IterativeCoverSearch search(DominoPlacements(4, 4), [&](const auto &solution) {
+    solutions.push_back(solution);
+    search_ptr->Suspend();
+  });
+  search_ptr = &search;
+  EXPECT_TRUE(search.Step(1000000));
+  ASSERT_EQ(solutions.size(), 1u);
+  EXPECT_TRUE(search.is_suspended());
+  EXPECT_EQ(search.CurrentPath(), solutions[0]);
+  // nothing happens while suspended
+  const auto steps = search.num_steps();
+  EXPECT_TRUE(search.Step(1000000));
+  EXPECT_EQ(search.num_steps(), steps);
+
+  search.Resume();
+  while (!search.done()) {
+    search.Step(1000000);
+    search.Resume();
+  }
+  EXPECT_EQ(solutions.size(), 36u);
+}
+
+TEST(IterativeCoverSearch, Checkpoint) {
+  const auto v = DominoPlacements(4, 6);
+  std::vector<std::vector<std::size_t>> expected;
+  ExhaustiveSolveCoverProblem(v, expected);
+
+  std::vector<std::vector<std::size_t>> solutions;
+  const auto on_solution = [&](const auto &solution) {
+    solutions.push_back(solution);
+  };
+  std::stringstream checkpoint;
+  {
+    IterativeCoverSearch search(v, on_solution);
+    search.Step(1000);
+    search.SaveCheckpoint(checkpoint);
+  }
+  ASSERT_FALSE(solutions.empty());
+  ASSERT_LT(solutions.size(), expected.size());
+  IterativeCoverSearch search(v, on_solution);
+  ASSERT_TRUE(search.LoadCheckpoint(checkpoint));
+  EXPECT_EQ(search.num_steps(), 1000u);
+  while (search.Step(1000)) {
+  }
+  EXPECT_EQ(solutions, expected);
+  EXPECT_EQ(search.num_solutions(), 281u);
+}
+
+TEST(IterativeCoverSearch, CheckpointOfOtherMatrix) {
+  std::stringstream checkpoint;
+  IterativeCoverSearch search(DominoPlacements(4, 4), {});
+  search.Step(100);
+  search.SaveCheckpoint(checkpoint);
+
+  IterativeCoverSearch other(DominoPlacements(4, 6), {});
+  EXPECT_FALSE(other.LoadCheckpoint(checkpoint));
+  EXPECT_TRUE(other.CurrentPath().empty());
+  std::stringstream garbage("not a checkpoint");
+  EXPECT_FALSE(other.LoadCheckpoint(garbage));
+}
+
+TEST(CoverZdd, AddNode) {
+  CoverZdd zdd;
+  // {{0}, {1, 2}}
+  const auto n2 = zdd.AddNode(2, CoverZdd::kEmpty, CoverZdd::kUnit);
+  const auto n1 = zdd.AddNode(1, CoverZdd::kEmpty, n2);
+  const auto n0 = zdd.AddNode(0, n1, CoverZdd::kUnit);
+  ASSERT_EQ(zdd.AddNode(2, CoverZdd::kEmpty, CoverZdd::kUnit), n2);
+  ASSERT_EQ(zdd.AddNode(3, n0, CoverZdd::kEmpty), n0);
+  zdd.SetRoot(n0);
+  ASSERT_EQ(zdd.size(), 5u);
+  ASSERT_EQ(zdd.CountSolutions(), 2u);
+  ASSERT_THAT(zdd.SolutionsPerRow(4), testing::ElementsAre(1, 1, 1, 0));
+  ASSERT_TRUE(zdd.ForcedRows().empty());
+}
+
+TEST(DLMatrix, BuildCoverZdd) {
+  const auto v = DominoPlacements(4, 6);
+  const auto zdd = BuildCoverZdd(v);
+  ASSERT_EQ(zdd.CountSolutions(), 281u);
+
+  std::vector<std::vector<std::size_t>> solutions;
+  ExhaustiveSolveCoverProblem(v, solutions);
+  std::vector<uint64_t> expected_per_row(v.size());
+  for (const auto &solution : solutions) {
+    for (const auto row : solution) {
+      ++expected_per_row[row];
+    }
+  }
+  ASSERT_EQ(zdd.SolutionsPerRow(v.size()), expected_per_row);
+}
+
+TEST(DLMatrix, BuildCoverZddNoSolution) {
+  const auto zdd = BuildCoverZdd(DominoPlacements(3, 3));
+  ASSERT_EQ(zdd.CountSolutions(), 0u);
+  ASSERT_TRUE(zdd.ForcedRows().empty());
+  std::mt19937_64 rng(0);
+  ASSERT_TRUE(zdd.SampleSolution(rng).empty());
+}
+
+TEST(DLMatrix, CoverZddForcedRows) {
+  // the 2x3 board has three tilings, the extra domino is the only way to
+  // cover cells 6 and 7
+  std::vector<uint64_t> v = DominoPlacements(2, 3);
+  v.push_back(0b11 << 6);
+  const auto zdd = BuildCoverZdd(v);
+  ASSERT_EQ(zdd.CountSolutions(), 3u);
+  ASSERT_THAT(zdd.ForcedRows(), testing::ElementsAre(v.size() - 1));
+}
+
+TEST(DLMatrix, CoverZddSampleSolution) {
+  // 2x4 board, five tilings
+  const auto v = DominoPlacements(2, 4);
+  const auto zdd = BuildCoverZdd(v);
+  ASSERT_EQ(zdd.CountSolutions(), 5u);
+  std::mt19937_64 rng(42);
+  std::map<std::vector<std::size_t>, int> histogram;
+  for (int i = 0; i < 5000; ++i) {
+    auto solution = zdd.SampleSolution(rng);
+    uint64_t covered = 0;
+    for (const auto row : solution) {
+      ASSERT_EQ(covered & v[row], 0u);
+      covered |= v[row];
+    }
+    ASSERT_EQ(covered, 0xffu);
+    std::sort(solution.begin(), solution.end());
+    ++histogram[solution];
+  }
+  ASSERT_EQ(histogram.size(), 5u);
+  for (const auto &[solution, count] : histogram) {
+    EXPECT_NEAR(count, 1000, 150);
+  }
+}
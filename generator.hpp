@@ -0,0 +1,86 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+// Lazy sequence of the values a coroutine co_yields: the coroutine runs up to
+// its next co_yield whenever the iterator advances, so a caller can stop after
+// any value and destroying the generator destroys the coroutine wherever it
+// is suspended. The values are references to what the coroutine yields and
+// stay valid until it resumes, which lets it yield a buffer it reuses. Like
+// std::generator of C++23, which the toolchain doesn't have yet.
+template <typename T> class Generator {
+public:
+  struct promise_type {
+    const T *value = nullptr;
+
+    Generator get_return_object() {
+      return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    // temporaries of the co_yield expression live until the coroutine
+    // resumes
+    std::suspend_always yield_value(const T &yielded) noexcept {
+      value = &yielded;
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() { throw; }
+    // a generator only suspends at co_yield
+    template <typename U> std::suspend_never await_transform(U &&) = delete;
+  };
+
+  class iterator {
+  public:
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(std::coroutine_handle<promise_type> coroutine)
+        : coroutine(coroutine) {}
+
+    const T &operator*() const { return *coroutine.promise().value; }
+    const T *operator->() const { return coroutine.promise().value; }
+    iterator &operator++() {
+      coroutine.resume();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const {
+      return !coroutine || coroutine.done();
+    }
+
+  private:
+    std::coroutine_handle<promise_type> coroutine;
+  };
+
+  Generator(Generator &&other) noexcept
+      : coroutine(std::exchange(other.coroutine, {})) {}
+  Generator &operator=(Generator &&other) noexcept {
+    std::swap(coroutine, other.coroutine);
+    return *this;
+  }
+  Generator(const Generator &) = delete;
+  Generator &operator=(const Generator &) = delete;
+  ~Generator() {
+    if (coroutine) {
+      coroutine.destroy();
+    }
+  }
+
+  // Runs the coroutine to its first value, call it once.
+  iterator begin() {
+    coroutine.resume();
+    return iterator(coroutine);
+  }
+  std::default_sentinel_t end() const { return {}; }
+
+private:
+  explicit Generator(std::coroutine_handle<promise_type> coroutine)
+      : coroutine(coroutine) {}
+
+  std::coroutine_handle<promise_type> coroutine;
+};
@@ -0,0 +1,99 @@
+#include "generator.hpp"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+Generator<int> Fibonacci() {
+  int a = 0;
+  int b = 1;
+  while (true) {
+    co_yield a;
+    a = std::exchange(b, a + b);
+  }
+}
+
+Generator<int> Range(int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    co_yield i;
+  }
+}
+
+// counts how often it was destroyed
+struct Guard {
+  int *destroyed;
+  ~Guard() { ++*destroyed; }
+};
+
+Generator<std::string> Words(int *destroyed) {
+  Guard guard{destroyed};
+  std::string word;
+  for (const char c : {'a', 'b', 'c'}) {
+    word += c;
+    co_yield word;
+  }
+}
+} // namespace
+
+TEST(Generator, TakeFirst) {
+  std::vector<int> values;
+  for (const int x : Fibonacci()) {
+    if (values.size() == 8) {
+      break;
+    }
+    values.push_back(x);
+  }
+  EXPECT_EQ(values, (std::vector<int>{0, 1, 1, 2, 3, 5, 8, 13}));
+}
+
+TEST(Generator, Finite) {
+  std::vector<int> values;
+  for (const int x : Range(3, 6)) {
+    values.push_back(x);
+  }
+  EXPECT_EQ(values, (std::vector<int>{3, 4, 5}));
+  for (const int x : Range(6, 6)) {
+    ADD_FAILURE() << x;
+  }
+}
+
+TEST(Generator, Interleaved) {
+  auto a = Range(0, 3);
+  auto b = Range(10, 12);
+  auto it_a = a.begin();
+  auto it_b = b.begin();
+  std::vector<int> values;
+  while (it_a != a.end() || it_b != b.end()) {
+    if (it_a != a.end()) {
+      values.push_back(*it_a);
+      ++it_a;
+    }
+    if (it_b != b.end()) {
+      values.push_back(*it_b);
+      ++it_b;
+    }
+  }
+  EXPECT_EQ(values, (std::vector<int>{0, 10, 1, 11, 2}));
+}
+
+TEST(Generator, DestroysSuspendedCoroutine) {
+  int destroyed = 0;
+  {
+    auto words = Words(&destroyed);
+    auto it = words.begin();
+    EXPECT_EQ(*it, "a");
+    ++it;
+    // the yielded buffer is reused
+    EXPECT_EQ(*it, "ab");
+    EXPECT_EQ(it->size(), 2u);
+  }
+  EXPECT_EQ(destroyed, 1);
+  std::vector<std::string> all;
+  for (const auto &word : Words(&destroyed)) {
+    all.push_back(word);
+  }
+  EXPECT_EQ(all, (std::vector<std::string>{"a", "ab", "abc"}));
+  EXPECT_EQ(destroyed, 2);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+// Vector with its elements stored in place, for the short per-search arrays
+// of the solvers whose length is bounded by the number of cells of a board.
+// It never allocates, which makes it cheap to construct once per
+// configuration. Only supports trivially destructible elements, growing past
+// kCapacity is a bug.
+template <typename T, std::size_t kCapacity> class InlineVector {
+  static_assert(std::is_trivially_destructible_v<T>);
+
+public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  InlineVector() = default;
+  InlineVector(std::size_t size, const T &value) { resize(size, value); }
+
+  static constexpr std::size_t capacity() { return kCapacity; }
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  T &operator[](std::size_t i) { return elements[i]; }
+  const T &operator[](std::size_t i) const { return elements[i]; }
+  T &back() { return elements[m_size - 1]; }
+  const T &back() const { return elements[m_size - 1]; }
+  T *data() { return elements.data(); }
+  const T *data() const { return elements.data(); }
+
+  iterator begin() { return elements.data(); }
+  iterator end() { return elements.data() + m_size; }
+  const_iterator begin() const { return elements.data(); }
+  const_iterator end() const { return elements.data() + m_size; }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  void push_back(const T &value) {
+    assert(m_size < kCapacity);
+    elements[m_size++] = value;
+  }
+  template <typename... ARGS> T &emplace_back(ARGS &&...args) {
+    assert(m_size < kCapacity);
+    return elements[m_size++] = T(std::forward<ARGS>(args)...);
+  }
+  void pop_back() { --m_size; }
+  void clear() { m_size = 0; }
+  void resize(std::size_t size, const T &value = T()) {
+    assert(size <= kCapacity);
+    for (std::size_t i = m_size; i < size; ++i) {
+      elements[i] = value;
+    }
+    m_size = size;
+  }
+
+private:
+  // only the first m_size are set, the others are not initialized for
+  // trivial types
+  std::array<T, kCapacity> elements;
+  std::size_t m_size = 0;
+};
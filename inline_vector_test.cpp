@@ -0,0 +1,36 @@
+#include "inline_vector.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <utility>
+
+TEST(InlineVector, PushAndPop) {
+  InlineVector<int, 4> v;
+  EXPECT_TRUE(v.empty());
+  v.push_back(3);
+  v.emplace_back(1);
+  v.push_back(2);
+  ASSERT_EQ(v.size(), 3u);
+  EXPECT_EQ(v.back(), 2);
+  std::sort(v.begin(), v.end());
+  EXPECT_EQ(v[0], 1);
+  EXPECT_EQ(v[1], 2);
+  EXPECT_EQ(v[2], 3);
+  v.pop_back();
+  EXPECT_EQ(v.size(), 2u);
+  v.clear();
+  EXPECT_TRUE(v.empty());
+}
+
+TEST(InlineVector, Resize) {
+  InlineVector<std::pair<int, int>, 8> v(2, {1, 2});
+  v.resize(4, {3, 4});
+  ASSERT_EQ(v.size(), 4u);
+  EXPECT_EQ(v[1], std::make_pair(1, 2));
+  EXPECT_EQ(v[3], std::make_pair(3, 4));
+  // shrinking and growing again sets the new elements
+  v.resize(1);
+  v.resize(2, {5, 6});
+  EXPECT_EQ(v[1], std::make_pair(5, 6));
+}
@@ -1,5 +1,6 @@
 #include "avx_match.hpp"
 #include "combinatorics.hpp"
+#include "configuration_filter.hpp"
 #include "partition_function.hpp"
 #include "polyominos.hpp"
 #include "puzzle_solver.hpp"
@@ -10,11 +11,14 @@
 #include <chrono>
 #include <cmath>
 #include <execution>
+#include <fstream>
 #include <iostream>
 #include <iterator>
 #include <map>
 #include <mutex>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -31,6 +35,19 @@ inline bool AcceptPartition(const std::vector<int> &partition, int N) {
   return true;
 }
 
+// Configurations sharing all but their largest pieces are solved with a
+// PrefixSolver if there are at least this many of them.
+constexpr uint64_t kMinPrefixSolverGroup = 16;
+
+// Configurations are first ranked by PuzzleSolver::SampleDifficulty with this
+// many probes, and only counted exactly if the upper bound of the sample
+// beats the most difficult one of the thread. The bounds are approximate, so
+// a sample can miss the most difficult configuration. 0 counts all of them
+// exactly. On a 29 cell board width 4 and 64 probes take 1/13 of the exact
+// count and rank 87% of the pairs of configurations the same way.
+constexpr std::size_t kDifficultyProbes = 0;
+constexpr std::size_t kDifficultyProbeWidth = 4;
+
 inline bool AcceptConfiguration(const std::vector<PolyominoSubsetIndex> &p) {
   // for (std::size_t i = 1; i < p.size(); ++i) {
   //   if (p[i - 1] == p[i]) {
@@ -40,7 +57,26 @@ inline bool AcceptConfiguration(const std::vector<PolyominoSubsetIndex> &p) {
   return true;
 }
 
-int main() {
+int main(int argc, char **argv) {
+  // --cost_model=<file> written by puzzle_solver_bench --calibrate solves
+  // with Algoritm::AUTO and that model instead of BF
+  std::optional<SolverCostModel> cost_model;
+  constexpr std::string_view kCostModel = "--cost_model=";
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg.starts_with(kCostModel)) {
+      const std::string path(arg.substr(kCostModel.size()));
+      std::ifstream in(path);
+      cost_model = SolverCostModel::Load(in);
+      if (!cost_model) {
+        std::cerr << "Can't read a cost model from " << path << "\n";
+        return 1;
+      }
+    }
+  }
+  const auto algo =
+      cost_model ? PuzzleSolver::Algoritm::AUTO : PuzzleSolver::Algoritm::BF;
+
   constexpr int N = 17;
   const auto &ps = PrecomputedPolyminosSet<N>::polyminos();
 
@@ -79,11 +115,28 @@ int main() {
 
 
   thread_local double tl_most_difficult{};
+  // Buffers of the configuration loop and the solvers, shared by all boards
+  // a thread works on so that the loop doesn't allocate once they have grown
+  // to the largest configuration.
+  struct ConfigurationBuffers {
+    std::vector<PolyominoSubsetIndex> p;
+    std::vector<PolyominoSubsetIndex> prefix;
+    std::vector<PolyominoSubsetIndex> suffix;
+    std::vector<std::size_t> solution;
+    SolverWorkspace workspace;
+  };
+  thread_local ConfigurationBuffers tl_buffers;
 
   std::mutex best_stats_mutex;
   double most_difficult{};
 
+  // dead ends found on one board prune the searches of other configurations
+  // and, for regions of the same shape, of other boards
+  SolvabilityCache solvability_cache;
+
   std::mutex count_mutex;
+  // rejections of the filters of all boards, under count_mutex
+  ConfigurationFilter::Stats filter_stats;
   int i = 0;
   uint64_t skipped_partitions{};
   std::chrono::steady_clock::time_point start_time =
@@ -92,6 +145,16 @@ int main() {
       std::execution::par_unseq,
       candidate_set.begin(), candidate_set.end(), [&](const auto &polyomino) {
         const PuzzleParams params{ps[polyomino]};
+        auto &[p, prefix, suffix, solution, workspace] = tl_buffers;
+        PuzzleSolver solver(
+            params, {.shared_cache = &solvability_cache,
+                     .cost_model = cost_model ? &*cost_model : nullptr,
+                     .workspace = &workspace});
+        ConfigurationFilter filter(params);
+        std::optional<PrefixSolver> prefix_solver;
+        if (params.N <= PrefixSolver::kMaxCells) {
+          prefix_solver.emplace(params);
+        }
         for (const auto &partition : partitions) {
           std::map<int, int> partition_map;
           for (auto p : partition) {
@@ -111,26 +174,51 @@ int main() {
           // ordered from largest to smallest and the indices into the output of
           // SubSetsRangeProduct are in the opposite order.
           std::reverse(sequences.begin(), sequences.end());
+          // The largest pieces come first in a configuration and change
+          // fastest, the others are the same for num_subsets() of them in a
+          // row. Decide those with the prefix solver, the others are placed
+          // once for all of them.
+          const std::size_t num_largest = partition_map.rbegin()->second;
+          const bool use_prefix_solver =
+              prefix_solver && sequences.size() > 1 &&
+              sequences.front().num_subsets() >= kMinPrefixSolverGroup;
           RangeProductRange<RangeType> r(std::move(sequences));
           std::for_each(
               //  std::execution::par_unseq,
-               r.begin(), r.end(), [&](std::vector<uint64_t> idx) {
-                std::vector<PolyominoSubsetIndex> p(idx.size());
+               r.begin(), r.end(), [&](const std::vector<uint64_t> &idx) {
+                p.resize(idx.size());
                 for (std::size_t i = 0; i < idx.size(); ++i) {
                   p[i] = PolyominoSubsetIndex{
                       static_cast<std::size_t>(partition[i]), idx[i]};
                 }
 
-                if (!AcceptConfiguration(p)) {
+                if (!AcceptConfiguration(p) || !filter.Accept(p)) {
                   return;
                 }
 
-                PreProcessConfiguration(p);
+                solution.clear();
 
-                PuzzleSolver solver(params);
-                std::vector<std::size_t> solution;
+                if (use_prefix_solver) {
+                  suffix.assign(p.begin(), p.begin() + num_largest);
+                  prefix.assign(p.rbegin(), p.rend() - num_largest);
+                  PreProcessConfiguration(prefix);
+                  prefix_solver->SetPrefix(prefix);
+                  if (!prefix_solver->Solve(suffix)) {
+                    return;
+                  }
+                }
+
+                PreProcessConfiguration(p);
 
-                if (!solver.Solve(p, solution)) {
+                if (!use_prefix_solver && !solver.Solve(p, solution, algo)) {
+                  return;
+                }
+                if (kDifficultyProbes > 0 &&
+                    solver
+                            .SampleDifficulty(
+                                p, {.probes = kDifficultyProbes,
+                                    .width = kDifficultyProbeWidth})
+                            .high <= tl_most_difficult) {
                   return;
                 }
                 double difficulty = solver.EstimateDifficulty(p);
@@ -140,7 +228,16 @@ int main() {
                   std::lock_guard lk(best_stats_mutex);
                   if (difficulty > most_difficult) {
                     most_difficult = difficulty;
+                    if (solution.empty()) {
+                      solver.Solve(p, solution, algo);
+                    }
+                    SolutionCounts solutions;
+                    solver.EstimateDifficulty(p, PuzzleSolver::Algoritm::BF,
+                                              &solutions);
                     std::cout << "\nDifficulty " << difficulty << "\n";
+                    std::cout << "Solutions: " << solutions.raw << " ("
+                              << solutions.up_to_symmetry
+                              << " up to symmetry)\n";
                     std::cout << "Decoded solution: \n";
                     std::cout
                         << solver.decodeSolution(ps[polyomino], solution, p)
@@ -179,6 +276,7 @@ int main() {
         }
         {
           std::lock_guard lk(count_mutex);
+          filter_stats.Merge(filter.stats());
           ++i;
           if ((i & 0xff) == 0) {
             auto dt = std::chrono::steady_clock::now() - start_time;
@@ -191,11 +289,25 @@ int main() {
                              (candidate_set.size() - i)
                       << "s " << std::setw(4) << skipped_partitions
                       << " skipped configurations"
+                      << " cache hit rate: " << std::setw(6)
+                      << solvability_cache.stats().hit_rate()
                       << "\r";
           }
         }
       });
-  std::cout << "\nDone\n";
+  const auto cache_stats = solvability_cache.stats();
+  std::cout << "\nDone, solvability cache: " << cache_stats.lookups
+            << " lookups, " << cache_stats.hits << " hits, "
+            << cache_stats.stores << " stores\n";
+  std::cout << "Filter: " << filter_stats.total_rejected() << " of "
+            << filter_stats.checked << " configurations rejected";
+  for (std::size_t rule = 0; rule < ConfigurationFilter::kNumRules; ++rule) {
+    std::cout << (rule == 0 ? " (" : ", ")
+              << ConfigurationFilter::RuleName(
+                     static_cast<ConfigurationFilter::Rule>(rule))
+              << ": " << filter_stats.rejected[rule];
+  }
+  std::cout << ")\n";
 
   return 0;
 }
@@ -1,4 +1,5 @@
 #include "puzzle_solver.hpp"
+#include "bit_matrix.hpp"
 #include "dl_matrix.hpp"
 #include "polyominos.hpp"
 
@@ -14,7 +15,11 @@
 #include <cstring>
 #include <iostream>
 #include <limits>
+#include <numeric>
 #include <optional>
+#include <random>
+#include <span>
+#include <tuple>
 #include <vector>
 
 template <int N> struct PrecomputedPolyminosMatchSet {
@@ -128,12 +133,126 @@ double PuzzleParams::possibilities_for_configuration(
   }
   return result;
 }
+
+SolverCostModel::Features PuzzleParams::cost_features(
+    const std::vector<PolyominoSubsetIndex> &configuration) const {
+  SolverCostModel::Features result;
+  result.cells = N;
+  if (configuration.empty()) {
+    return result;
+  }
+  double placements = 0;
+  for (std::size_t i = 0; i < configuration.size(); ++i) {
+    placements += operator[](configuration[i]).size();
+    if (std::find(configuration.begin(), configuration.begin() + i,
+                  configuration[i]) != configuration.begin() + i) {
+      ++result.repeated_pieces;
+    }
+  }
+  result.pieces = configuration.size();
+  result.log2_placements_per_piece =
+      std::log2(std::max(placements, 1.0) / configuration.size());
+  result.log2_possibilities = possibilities_for_configuration(configuration);
+  return result;
+}
+
 const std::vector<BitMaskType> &
 PuzzleParams::operator[](PolyominoSubsetIndex idx) const noexcept {
   return possible_tiles_per_size[idx.N - 1][idx.index].masks;
 }
 
 
+bool PuzzleParams::RegionsCanBeFilled(BitMaskType empty, uint64_t subset_sums,
+                                      std::size_t area, std::size_t slack,
+                                      std::size_t *num_regions) const noexcept {
+  std::size_t uncovered = 0;
+  std::size_t regions = 0;
+  while (empty != 0) {
+    const BitMaskType region = Region(empty, std::countr_zero(empty));
+    empty &= ~region;
+    ++regions;
+    const std::size_t size = std::popcount(region);
+    // the most cells the pieces can cover in this region
+    const std::size_t fitting =
+        size >= area
+            ? area
+            : 63 - std::countl_zero(subset_sums &
+                                    ((uint64_t{2} << size) - 1));
+    uncovered += size - fitting;
+    if (uncovered > slack) {
+      return false;
+    }
+  }
+  if (num_regions != nullptr) {
+    *num_regions = regions;
+  }
+  return true;
+}
+
+BitMaskType PuzzleParams::Region(BitMaskType empty,
+                                 std::size_t cell) const noexcept {
+  BitMaskType region = BitMaskType{1} << cell;
+  BitMaskType frontier = region;
+  while (frontier != 0) {
+    BitMaskType next = 0;
+    for (; frontier != 0; frontier &= frontier - 1) {
+      next |= neighbours[std::countr_zero(frontier)];
+    }
+    frontier = next & empty & ~region;
+    region |= frontier;
+  }
+  return region;
+}
+
+BitMaskType PuzzleParams::Permute(BitMaskType cells,
+                                  std::size_t automorphism) const noexcept {
+  const auto &to = automorphisms[automorphism];
+  BitMaskType result = 0;
+  for (; cells != 0; cells &= cells - 1) {
+    result |= BitMaskType{1} << to[std::countr_zero(cells)];
+  }
+  return result;
+}
+
+void PuzzleParams::setAutomorphisms(
+    const std::vector<std::vector<std::pair<int8_t, int8_t>>> &images) {
+  const auto aligned = [](std::vector<std::pair<int8_t, int8_t>> cells) {
+    int8_t x_min = cells[0].first;
+    int8_t y_min = cells[0].second;
+    for (const auto &[x, y] : cells) {
+      x_min = std::min(x_min, x);
+      y_min = std::min(y_min, y);
+    }
+    for (auto &[x, y] : cells) {
+      x -= x_min;
+      y -= y_min;
+    }
+    return cells;
+  };
+  // the board itself in the order of cells
+  const auto board = aligned(images[0]);
+  auto sorted_board = board;
+  std::sort(sorted_board.begin(), sorted_board.end());
+  for (const auto &image : images) {
+    const auto moved = aligned(image);
+    auto sorted_moved = moved;
+    std::sort(sorted_moved.begin(), sorted_moved.end());
+    if (sorted_moved != sorted_board) {
+      continue;
+    }
+    std::vector<uint8_t> permutation(N);
+    for (std::size_t i = 0; i < N; ++i) {
+      permutation[i] =
+          std::find(board.begin(), board.end(), moved[i]) - board.begin();
+    }
+    // symmetries of small boards can coincide
+    if (std::find(automorphisms.begin(), automorphisms.end(), permutation) ==
+        automorphisms.end()) {
+      automorphisms.push_back(std::move(permutation));
+    }
+  }
+}
+
 const std::vector<std::pair<int8_t, int8_t>> &
 PuzzleParams::xy_coordinates(PolyominoSubsetIndex idx) const noexcept {
   const auto global_idx =
@@ -141,52 +260,841 @@ PuzzleParams::xy_coordinates(PolyominoSubsetIndex idx) const noexcept {
   return kPrecomputedPolyominosTypeErased[global_idx.N - 1][global_idx.index];
 }
 
-PuzzleSolver::PuzzleSolver(const PuzzleParams &params) : params(params) {}
+struct PuzzleSolver::PlacementMatrix {
+  explicit PlacementMatrix(const PuzzleParams &params)
+      : matrix(Rows(params), params.N + NumTiles(params), params.N) {}
+
+  static std::size_t NumTiles(const PuzzleParams &params) {
+    std::size_t result = 0;
+    for (const auto &tiles : params.possible_tiles_per_size) {
+      result += tiles.size();
+    }
+    return result;
+  }
+
+  // Cells are the first columns, followed by one column per piece.
+  std::vector<std::vector<DLMatrix::ColumnIndex>>
+  Rows(const PuzzleParams &params) {
+    std::vector<std::vector<DLMatrix::ColumnIndex>> rows;
+    DLMatrix::ColumnIndex col = params.N;
+    for (std::size_t size = 1; size <= kMaxPolyominoSize; ++size) {
+      for (std::size_t index = 0;
+           index < params.possible_tiles_per_size[size - 1].size(); ++index) {
+        const PolyominoSubsetIndex tile{size, index};
+        tile_column[size - 1].push_back(col);
+        tile_first_row[size - 1].push_back(rows.size());
+        std::size_t mask_index = 0;
+        for (const auto mask : params[tile]) {
+          auto &row = rows.emplace_back();
+          for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+            row.push_back(std::countr_zero(bits));
+          }
+          row.push_back(col);
+          row_to_tile.push_back(tile);
+          row_to_mask_index.push_back(mask_index++);
+        }
+        ++col;
+      }
+    }
+    return rows;
+  }
+
+  std::array<std::vector<DLMatrix::ColumnIndex>, kMaxPolyominoSize>
+      tile_column;
+  std::array<std::vector<DLMatrix::RowIndex>, kMaxPolyominoSize>
+      tile_first_row;
+  std::vector<PolyominoSubsetIndex> row_to_tile;
+  std::vector<std::size_t> row_to_mask_index;
+  DLMatrix matrix;
+
+  // Region pruning for the DLX search: the uncovered cells have to be filled
+  // exactly by the pieces whose columns still need rows, monominos included.
+  void EnableRegionPruning(const PuzzleParams &params) {
+    std::vector<std::size_t> column_piece_size(matrix.col_headers.size(), 0);
+    for (std::size_t size = 1; size <= kMaxPolyominoSize; ++size) {
+      for (const auto col : tile_column[size - 1]) {
+        column_piece_size[col] = size;
+      }
+    }
+    matrix.SetPruneHook([this, &params, column_piece_size]() {
+      BitMaskType empty = 0;
+      uint64_t subset_sums = 1;
+      std::size_t area = 0;
+      matrix.VisitActiveColumns([&](DLMatrix::ColumnIndex col,
+                                    const DLMatrix::ColHeader &header) {
+        if (static_cast<std::size_t>(col) < params.N) {
+          empty |= BitMaskType{1} << col;
+          return;
+        }
+        const auto size = column_piece_size[col];
+        for (std::size_t i = 0; i < header.multiplicity; ++i) {
+          subset_sums |= subset_sums << size;
+        }
+        area += size * header.multiplicity;
+      });
+      return params.RegionsCanBeFilled(empty, subset_sums, area, 0);
+    });
+  }
+};
+
+PuzzleSolver::PuzzleSolver(const PuzzleParams &params)
+    : PuzzleSolver(params, Options{}) {}
+
+namespace {
+// splitmix64 finalizer
+uint64_t Mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+uint64_t HashBytes(const std::string &bytes, uint64_t seed) {
+  uint64_t h = seed;
+  for (const char c : bytes) {
+    h = Mix(h ^ static_cast<uint8_t>(c));
+  }
+  return Mix(h ^ bytes.size());
+}
+
+uint64_t BoardHash(const PuzzleParams &params) {
+  uint64_t h = Mix(params.N);
+  for (const auto &[x, y] : params.cells) {
+    h = Mix(h ^ (static_cast<uint8_t>(x) << 8 | static_cast<uint8_t>(y)));
+  }
+  return h;
+}
+} // namespace
+
+PuzzleSolver::PuzzleSolver(const PuzzleParams &params, const Options &options)
+    : params(params), options(options), board_hash(BoardHash(params)) {}
+
+PuzzleSolver::~PuzzleSolver() = default;
+
+namespace {
+// placements are the (index of a piece in candidate_tiles, index of the mask)
+// pairs of a solution, where the piece index can be that of any copy of the
+// piece. The placements of a piece are handed out to its copies in increasing
+// order, placements without a copy left are dropped.
+void AssignPlacementsToCopies(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+    std::span<std::pair<std::size_t, std::size_t>> placements,
+    std::vector<std::size_t> &solution) {
+  solution.resize(candidate_tiles.size());
+  std::sort(placements.begin(), placements.end());
+  // a configuration with a solution has at most kMaxPieces pieces
+  InlineVector<std::size_t, kMaxPieces> next_copy(candidate_tiles.size(), 0);
+  std::iota(next_copy.begin(), next_copy.end(), 0);
+  for (const auto &[tile_idx, mask_idx] : placements) {
+    auto &copy = next_copy[tile_idx];
+    if (copy >= candidate_tiles.size()) {
+      continue;
+    }
+    solution[copy] = mask_idx;
+    do {
+      ++copy;
+    } while (copy < candidate_tiles.size() &&
+             candidate_tiles[copy] != candidate_tiles[tile_idx]);
+  }
+}
+
+BitMaskType FullMask(std::size_t num_cells) {
+  return num_cells == 64 ? ~BitMaskType{0}
+                         : (BitMaskType{1} << num_cells) - 1;
+}
+
+// Runtime counterpart of Polyomino::canonical for the shape formed by the
+// cells of region: the smallest of its 8 symmetries once aligned to the
+// origin and sorted by (y, x), as bytes.
+std::string CanonicalRegion(const PuzzleParams &params, BitMaskType region) {
+  std::vector<std::pair<int8_t, int8_t>> cells;
+  for (; region != 0; region &= region - 1) {
+    cells.push_back(params.cells[std::countr_zero(region)]);
+  }
+  std::vector<std::pair<int8_t, int8_t>> best;
+  std::vector<std::pair<int8_t, int8_t>> p(cells.size());
+  for (int symmetry = 0; symmetry < 8; ++symmetry) {
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+      auto [x, y] = cells[i];
+      // rotate_90 `symmetry % 4` times, then flip_x for the second half
+      for (int r = 0; r < symmetry % 4; ++r) {
+        const int8_t rotated_x = y;
+        y = -x;
+        x = rotated_x;
+      }
+      p[i] = {symmetry >= 4 ? -x : x, y};
+    }
+    int8_t x_min = p[0].first;
+    int8_t y_min = p[0].second;
+    for (const auto &[x, y] : p) {
+      x_min = std::min(x_min, x);
+      y_min = std::min(y_min, y);
+    }
+    for (auto &[x, y] : p) {
+      x -= x_min;
+      y -= y_min;
+    }
+    std::sort(p.begin(), p.end(), [](const auto &a, const auto &b) {
+      return std::make_pair(a.second, a.first) <
+             std::make_pair(b.second, b.first);
+    });
+    if (best.empty() || p < best) {
+      best = p;
+    }
+  }
+  std::string result;
+  for (const auto &[x, y] : best) {
+    result.push_back(x);
+    result.push_back(y);
+  }
+  return result;
+}
+
+// Splits a multiset of pieces among regions such that can_pack(region,
+// pieces) holds for every region, leaving at most `holes` cells uncovered in
+// total. Regions are handled in order, the last one takes all pieces left.
+template <typename CAN_PACK> class RegionSplitter {
+public:
+  RegionSplitter(const std::vector<BitMaskType> &regions,
+                 std::vector<std::pair<PolyominoSubsetIndex, std::size_t>>
+                     pieces_left,
+                 std::size_t holes, CAN_PACK can_pack)
+      : regions(regions), left(std::move(pieces_left)), holes(holes),
+        can_pack(can_pack), split(regions.size()) {}
+
+  bool Split(std::size_t region = 0) {
+    if (region + 1 == regions.size()) {
+      for (const auto &[tile, count] : left) {
+        split[region].insert(split[region].end(), count, tile);
+      }
+      const bool ok = Fits(region) && can_pack(regions[region], split[region]);
+      if (!ok) {
+        split[region].clear();
+      }
+      return ok;
+    }
+    return Choose(region, 0);
+  }
+
+  // split[r]: the pieces of regions[r], only valid after Split succeeded
+  const std::vector<std::vector<PolyominoSubsetIndex>> &pieces() const {
+    return split;
+  }
+
+private:
+  bool Fits(std::size_t region) const {
+    const std::size_t area = Area(split[region]);
+    const std::size_t size = std::popcount(regions[region]);
+    return area <= size && size - area <= holes;
+  }
+
+  // picks between 0 and all of the pieces of type t for region
+  bool Choose(std::size_t region, std::size_t t) {
+    if (t == left.size()) {
+      if (!Fits(region) || !can_pack(regions[region], split[region])) {
+        return false;
+      }
+      const std::size_t hole_cells =
+          std::popcount(regions[region]) - Area(split[region]);
+      holes -= hole_cells;
+      if (Split(region + 1)) {
+        return true;
+      }
+      holes += hole_cells;
+      return false;
+    }
+    const std::size_t size = std::popcount(regions[region]);
+    const std::size_t count = left[t].second;
+    std::size_t taken = 0;
+    while (true) {
+      if (Choose(region, t + 1)) {
+        return true;
+      }
+      if (taken == count ||
+          Area(split[region]) + left[t].first.N > size) {
+        break;
+      }
+      split[region].push_back(left[t].first);
+      --left[t].second;
+      ++taken;
+    }
+    split[region].resize(split[region].size() - taken);
+    left[t].second += taken;
+    return false;
+  }
+
+  static std::size_t Area(const std::vector<PolyominoSubsetIndex> &pieces) {
+    std::size_t area = 0;
+    for (const auto &tile : pieces) {
+      area += tile.N;
+    }
+    return area;
+  }
+
+  const std::vector<BitMaskType> &regions;
+  std::vector<std::pair<PolyominoSubsetIndex, std::size_t>> left;
+  std::size_t holes;
+  CAN_PACK can_pack;
+  std::vector<std::vector<PolyominoSubsetIndex>> split;
+};
+
+// entries of PuzzleSolver::region_cache, and of region_shapes, before it is
+// cleared
+constexpr std::size_t kMaxRegionCacheSize = 1 << 20;
+// CrossProduct reserves room for all pairs of masks up to this many
+constexpr std::size_t kMaxCrossProductReserve = 1 << 16;
+
+// One count of EstimateDifficulty, of the ways to place the pieces less one
+// copy of left_out (the number of distinct pieces for none).
+struct DifficultyCount {
+  std::size_t left_out;
+  SearchStats stats{};
+  // ways counted so far
+  uint64_t counted = 0;
+  bool cut_off = false;
+};
+} // namespace
+
+struct SolverWorkspace::Buffers {
+  // rows of the solution of the DLX and BITSET searches
+  std::vector<std::size_t> rows;
+  // rows of the BITSET matrix, the pieces and placements they stand for, and
+  // the row ranges of the distinct pieces
+  std::vector<BitMatrix::RowMask> bitset_rows;
+  std::vector<std::size_t> row_idx_to_tile;
+  std::vector<std::size_t> row_idx_to_mask_index_of_tile;
+  std::vector<std::pair<std::size_t, std::size_t>> limits;
+  // distinct pieces of EstimateDifficulty and its counts for every piece
+  // left out
+  std::vector<std::pair<PolyominoSubsetIndex, std::size_t>> pieces;
+  std::vector<DifficultyCount> left_out;
+};
+
+SolverWorkspace::SolverWorkspace() : buffers(std::make_unique<Buffers>()) {}
+
+SolverWorkspace::~SolverWorkspace() = default;
+
+SolverWorkspace::Buffers &PuzzleSolver::buffers() noexcept {
+  return options.workspace ? *options.workspace->buffers
+                           : *own_workspace.buffers;
+}
+
+struct PuzzleSolver::BruteForceProblem {
+  BruteForceProblem(const std::vector<PolyominoSubsetIndex> &tiles,
+                    std::size_t num_cells, uint32_t generation)
+      : tiles(tiles), generation(generation) {
+    std::size_t area = 0;
+    for (const auto &tile : tiles) {
+      area += tile.N;
+    }
+    fits = area <= num_cells;
+    slack = fits ? num_cells - area : 0;
+    if (!fits) {
+      // nothing to search, and maybe more than kMaxPieces pieces
+      return;
+    }
+    suffix_subset_sums.resize(tiles.size() + 1, 1);
+    suffix_area.resize(tiles.size() + 1, 0);
+    for (std::size_t i = tiles.size(); i-- > 0;) {
+      suffix_subset_sums[i] =
+          suffix_subset_sums[i + 1] | (suffix_subset_sums[i + 1] << tiles[i].N);
+      suffix_area[i] = suffix_area[i + 1] + tiles[i].N;
+    }
+  }
+
+  const std::vector<PolyominoSubsetIndex> &tiles;
+  // subset sums and area of the pieces from index i on, empty unless fits
+  InlineVector<uint64_t, kMaxPieces + 1> suffix_subset_sums;
+  InlineVector<std::size_t, kMaxPieces + 1> suffix_area;
+  // cells left uncovered once all pieces are placed
+  std::size_t slack;
+  bool fits;
+  // of PuzzleSolver::dead_states, 0 if not used
+  uint32_t generation;
+};
+
+struct PuzzleSolver::CellSearch {
+  CellSearch(const PuzzleParams &params,
+             const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+             std::size_t holes, uint32_t generation)
+      : holes(holes), generation(generation) {
+    for (std::size_t i = 0; i < candidate_tiles.size(); ++i) {
+      const std::size_t t =
+          std::find(tiles.begin(), tiles.end(), candidate_tiles[i]) -
+          tiles.begin();
+      if (t == tiles.size()) {
+        tiles.push_back(candidate_tiles[i]);
+        tile_idx.push_back(i);
+        remaining.push_back(0);
+        // pseudo random, so that sums of them tell the remaining counts
+        // apart unless they happen to collide modulo 2^64. Derived from the
+        // global polyomino index to be the same for every board.
+        const auto shape = params.possible_tiles_per_size[tiles.back().N - 1]
+                                                         [tiles.back().index]
+                                                             .polyomino_index;
+        tile_hash.push_back(Mix(shape.N << 32 | shape.index));
+      }
+      ++remaining[t];
+      remaining_hash += tile_hash[t];
+    }
+    for (const auto &tile : candidate_tiles) {
+      area += tile.N;
+    }
+  }
+
+  // the distinct pieces, the index of one of their copies in the
+  // configuration, and how many copies are left to place. The pieces fit on
+  // the board, so there are at most kMaxPieces.
+  InlineVector<PolyominoSubsetIndex, kMaxPieces> tiles;
+  InlineVector<std::size_t, kMaxPieces> tile_idx;
+  InlineVector<std::size_t, kMaxPieces> remaining;
+  // by_cell[t][cell]: placements of tiles[t] covering cell
+  InlineVector<const std::vector<std::vector<uint32_t>> *, kMaxPieces> by_cell;
+  // area of the pieces left to place
+  std::size_t area{};
+  // cells that may stay empty
+  std::size_t holes;
+  // (index into tiles, mask index) of the pieces placed so far
+  InlineVector<std::pair<std::size_t, std::size_t>, kMaxPieces> placed;
+  // sum of tile_hash[t] * remaining[t], with the occupied cells the key of
+  // the state in PuzzleSolver::dead_states
+  InlineVector<uint64_t, kMaxPieces> tile_hash;
+  uint64_t remaining_hash{};
+  uint32_t generation;
+  // Set by SolveAtMost, which collects the solutions as those of
+  // candidate_tiles in solutions until it has max_solutions of them
+  const std::vector<PolyominoSubsetIndex> *candidate_tiles = nullptr;
+  std::vector<std::vector<std::size_t>> *solutions = nullptr;
+  std::size_t max_solutions = 1;
+};
+
+static_assert(static_cast<std::size_t>(PuzzleSolver::Algoritm::AUTO) ==
+              SolverCostModel::kNumBackends);
+
+PuzzleSolver::Algoritm PuzzleSolver::ChooseAlgorithm(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles) const noexcept {
+  static const SolverCostModel kDefaultModel = SolverCostModel::Default();
+  const SolverCostModel &model =
+      options.cost_model ? *options.cost_model : kDefaultModel;
+  return static_cast<Algoritm>(
+      model.Cheapest(params.cost_features(candidate_tiles)));
+}
+
+template <typename SEARCH>
+void PuzzleSolver::withPlacementRows(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles, std::size_t area,
+    SEARCH &&search) noexcept {
+  if (!placement_matrix) {
+    placement_matrix = std::make_unique<PlacementMatrix>(params);
+    // the cells are the preferred columns
+    placement_matrix->matrix.SetHeuristic(options.dlx_heuristic, params.N);
+    if (options.prune_regions) {
+      placement_matrix->EnableRegionPruning(params);
+    }
+  }
+  auto &pm = *placement_matrix;
+  // One column per distinct piece that has to be covered as often as the
+  // piece appears, so identical pieces do not multiply the search. Cells
+  // the pieces leave empty are covered by as many monominos as needed.
+  // the pieces cover at most kMaxPieces cells, the monominos one more
+  InlineVector<std::pair<PolyominoSubsetIndex, std::size_t>, kMaxPieces + 1>
+      counts;
+  const auto add_tile = [&](PolyominoSubsetIndex tile, std::size_t count) {
+    auto it = std::find_if(counts.begin(), counts.end(), [&](const auto &c) {
+      return c.first == tile;
+    });
+    if (it == counts.end()) {
+      counts.emplace_back(tile, count);
+    } else {
+      it->second += count;
+    }
+  };
+  for (const auto &tile : candidate_tiles) {
+    add_tile(tile, 1);
+  }
+  if (area < params.N) {
+    add_tile(PolyominoSubsetIndex{1, 0}, params.N - area);
+  }
+  for (const auto &[tile, count] : counts) {
+    pm.matrix.ActivateColumn(pm.tile_column[tile.N - 1][tile.index], count);
+  }
+  for (const auto &[tile, count] : counts) {
+    const DLMatrix::RowIndex first = pm.tile_first_row[tile.N - 1][tile.index];
+    for (std::size_t i = 0; i < params[tile].size(); ++i) {
+      pm.matrix.ActivateRow(first + i);
+    }
+  }
+  search(pm.matrix);
+  search_stats.Merge(pm.matrix.stats());
+  pm.matrix.ClearStats();
+  for (auto it = counts.rbegin(); it != counts.rend(); ++it) {
+    const auto tile = it->first;
+    const DLMatrix::RowIndex first = pm.tile_first_row[tile.N - 1][tile.index];
+    for (std::size_t i = params[tile].size(); i-- > 0;) {
+      pm.matrix.DeactivateRow(first + i);
+    }
+  }
+  for (auto it = counts.rbegin(); it != counts.rend(); ++it) {
+    const auto tile = it->first;
+    pm.matrix.DeactivateColumn(pm.tile_column[tile.N - 1][tile.index]);
+  }
+}
+
+void PuzzleSolver::dlxSolution(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+    const std::vector<std::size_t> &rows,
+    std::vector<std::size_t> &solution) const noexcept {
+  const auto &pm = *placement_matrix;
+  InlineVector<std::pair<std::size_t, std::size_t>, kMaxPieces> placements;
+  for (const auto row : rows) {
+    const auto it = std::find(candidate_tiles.begin(), candidate_tiles.end(),
+                              pm.row_to_tile[row]);
+    if (it != candidate_tiles.end()) {
+      placements.emplace_back(it - candidate_tiles.begin(),
+                              pm.row_to_mask_index[row]);
+    }
+  }
+  AssignPlacementsToCopies(candidate_tiles, placements, solution);
+}
 
 bool PuzzleSolver::Solve(
     const std::vector<PolyominoSubsetIndex> &candidate_tiles,
-    std::vector<std::size_t> &solution, Algoritm algo) const noexcept {
-  if (algo != Algoritm::DLX) {
-    std::vector<uint64_t> v;
-    uint64_t tile_marker = uint64_t{1} << params.N;
-    std::vector<std::size_t> row_idx_to_mask_index_of_tile;
+    std::vector<std::size_t> &solution, Algoritm algo) noexcept {
+  switch (algo) {
+  case Algoritm::AUTO:
+    return Solve(candidate_tiles, solution, ChooseAlgorithm(candidate_tiles));
+  case Algoritm::MITM:
+    if (params.N > MeetInTheMiddleSolver::kMaxCells) {
+      return Solve(candidate_tiles, solution, Algoritm::BF);
+    }
+    if (!meet_in_the_middle) {
+      meet_in_the_middle = std::make_unique<MeetInTheMiddleSolver>(params);
+    }
+    return meet_in_the_middle->Solve(candidate_tiles, solution);
+  case Algoritm::DLX: {
+    std::size_t area = 0;
     for (const auto &tile : candidate_tiles) {
-      std::size_t sol_idx = 0;
-      for (const auto l : params[tile]) {
-        uint64_t line = l;
-        line |= tile_marker;
-        v.push_back(line);
-        row_idx_to_mask_index_of_tile.push_back(sol_idx);
-        ++sol_idx;
-      }
-      tile_marker <<= 1;
-    }
-    std::vector<std::size_t> rows;
-    DLMatrix dl_matrix(v);
-    if (SolveCoverProblem(dl_matrix, rows)) {
-      solution.resize(candidate_tiles.size());
-      for (const auto row_idx : rows) {
-        const auto r = v[row_idx];
-        const auto tile_index = std::countr_zero(r >> params.N);
-        solution[tile_index] = row_idx_to_mask_index_of_tile[row_idx];
+      area += tile.N;
+    }
+    if (area > params.N) {
+      return false;
+    }
+    auto &rows = buffers().rows;
+    bool found = false;
+    withPlacementRows(candidate_tiles, area, [&](DLMatrix &matrix) {
+      rows.clear();
+      found = SolveCoverProblem(matrix, rows);
+    });
+    if (!found) {
+      return false;
+    }
+    dlxSolution(candidate_tiles, rows, solution);
+    return true;
+  }
+  case Algoritm::BITSET: {
+    if (params.N + candidate_tiles.size() > BitMatrix::kMaxColumns) {
+      return Solve(candidate_tiles, solution, Algoritm::BF);
+    }
+    std::size_t area = 0;
+    std::size_t max_rows = 0;
+    for (const auto &tile : candidate_tiles) {
+      area += tile.N;
+      max_rows += params[tile].size();
+    }
+    auto &buf = buffers();
+    auto &v = buf.bitset_rows;
+    auto &row_idx_to_tile = buf.row_idx_to_tile;
+    auto &row_idx_to_mask_index_of_tile = buf.row_idx_to_mask_index_of_tile;
+    v.clear();
+    row_idx_to_tile.clear();
+    row_idx_to_mask_index_of_tile.clear();
+    v.reserve(max_rows);
+    row_idx_to_tile.reserve(max_rows);
+    row_idx_to_mask_index_of_tile.reserve(max_rows);
+    // first row and number of copies of every distinct piece
+    auto &limits = buf.limits;
+    limits.clear();
+    BitMatrix::RowMask primary = {};
+    if (area == params.N) {
+      // The pieces fill the board, so it is enough to cover every cell and
+      // to use every distinct piece at most as often as it appears.
+      for (std::size_t tile_idx = 0; tile_idx < candidate_tiles.size();
+           ++tile_idx) {
+        const auto &tile = candidate_tiles[tile_idx];
+        if (std::find(candidate_tiles.begin(),
+                      candidate_tiles.begin() + tile_idx,
+                      tile) != candidate_tiles.begin() + tile_idx) {
+          continue;
+        }
+        limits.emplace_back(
+            v.size(),
+            std::count(candidate_tiles.begin(), candidate_tiles.end(), tile));
+        std::size_t sol_idx = 0;
+        for (const auto mask : params[tile]) {
+          v.push_back(BitMatrix::RowMask{mask, 0});
+          row_idx_to_tile.push_back(tile_idx);
+          row_idx_to_mask_index_of_tile.push_back(sol_idx);
+          ++sol_idx;
+        }
+      }
+      primary[0] = params.N == 64 ? ~uint64_t{0}
+                                  : (uint64_t{1} << params.N) - 1;
+    } else {
+      // Otherwise every piece gets a marker column that has to be covered and
+      // the cells only have to be covered at most once, like in
+      // internalSolve.
+      for (std::size_t tile_idx = 0; tile_idx < candidate_tiles.size();
+           ++tile_idx) {
+        const auto &tile = candidate_tiles[tile_idx];
+        const std::size_t marker_col = params.N + tile_idx;
+        primary[marker_col / 64] |= uint64_t{1} << (marker_col % 64);
+        std::size_t sol_idx = 0;
+        for (const auto mask : params[tile]) {
+          BitMatrix::RowMask line = {mask, 0};
+          line[marker_col / 64] |= uint64_t{1} << (marker_col % 64);
+          v.push_back(line);
+          row_idx_to_tile.push_back(tile_idx);
+          row_idx_to_mask_index_of_tile.push_back(sol_idx);
+          ++sol_idx;
+        }
+      }
+    }
+    BitMatrix bit_matrix(v, primary);
+    for (std::size_t i = 0; i < limits.size(); ++i) {
+      bit_matrix.LimitRows(limits[i].first,
+                           i + 1 < limits.size() ? limits[i + 1].first
+                                                 : v.size(),
+                           limits[i].second);
+    }
+    // Identical pieces take their placements in increasing order, the same
+    // trick as start_offset in internalSolve.
+    for (std::size_t row_a = 0; limits.empty() && row_a < v.size(); ++row_a) {
+      for (std::size_t row_b = row_a + 1; row_b < v.size(); ++row_b) {
+        const auto tile_a = row_idx_to_tile[row_a];
+        const auto tile_b = row_idx_to_tile[row_b];
+        if (tile_a != tile_b &&
+            candidate_tiles[tile_a] == candidate_tiles[tile_b] &&
+            row_idx_to_mask_index_of_tile[row_a] >=
+                row_idx_to_mask_index_of_tile[row_b]) {
+          bit_matrix.AddConflict(row_a, row_b);
+        }
+      }
+    }
+    auto &rows = buf.rows;
+    rows.clear();
+    if (SolveCoverProblem(bit_matrix, rows)) {
+      InlineVector<std::pair<std::size_t, std::size_t>, kMaxPieces> placements;
+      for (const auto row : rows) {
+        placements.emplace_back(row_idx_to_tile[row],
+                                row_idx_to_mask_index_of_tile[row]);
       }
+      AssignPlacementsToCopies(candidate_tiles, placements, solution);
+      return true;
+    }
+    return false;
+  }
+  case Algoritm::BF: {
+    const BruteForceProblem problem(candidate_tiles, params.N,
+                                    newDeadStatesGeneration());
+    if (!problem.fits) {
+      return false;
+    }
+    if (options.bf_branching == Branching::CELLS) {
+      CellSearch search(params, candidate_tiles, problem.slack,
+                        problem.generation);
+      // of the pieces that appear once the one with the fewest classes of
+      // symmetric placements
+      std::size_t symmetric_piece = search.tiles.size();
+      std::size_t fewest_classes = std::numeric_limits<std::size_t>::max();
+      for (std::size_t t = 0; t < search.tiles.size(); ++t) {
+        search.by_cell.push_back(&placementsByCell(search.tiles[t]));
+        if (options.break_symmetries && params.automorphisms.size() > 1 &&
+            search.remaining[t] == 1) {
+          const auto &classes = placementClasses(search.tiles[t]);
+          if (!classes.empty() && classes.size() < fewest_classes) {
+            symmetric_piece = t;
+            fewest_classes = classes.size();
+          }
+        }
+      }
+      if (symmetric_piece < search.tiles.size()
+              ? !cellSolveSymmetric(search, symmetric_piece)
+              : !cellSolve(search, 0)) {
+        solution.clear();
+        return false;
+      }
+      InlineVector<std::pair<std::size_t, std::size_t>, kMaxPieces> placements;
+      for (const auto &[t, mask_idx] : search.placed) {
+        placements.emplace_back(search.tile_idx[t], mask_idx);
+      }
+      AssignPlacementsToCopies(candidate_tiles, placements, solution);
       return true;
     }
-  } else if (algo == Algoritm::BF) {
     solution.resize(candidate_tiles.size());
-    if (!internalSolve(candidate_tiles, solution)) {
+    if (!(options.decompose_regions ? internalSolve<true>(problem, solution)
+                                    : internalSolve<false>(problem, solution))) {
       solution.clear();
       return false;
     }
     return true;
   }
+  }
   return false;
 }
 
-bool PuzzleSolver::internalSolve(
+std::size_t PuzzleSolver::SolveAtMost(
     const std::vector<PolyominoSubsetIndex> &candidate_tiles,
-    std::vector<std::size_t> &indices, BitMaskType current_state,
-    std::size_t current_index) const noexcept {
+    std::size_t max_solutions, std::vector<std::vector<std::size_t>> &solutions,
+    Algoritm algo) noexcept {
+  solutions.clear();
+  if (max_solutions == 0) {
+    return 0;
+  }
+  if (algo == Algoritm::AUTO) {
+    algo = ChooseAlgorithm(candidate_tiles);
+  }
+  std::size_t area = 0;
+  for (const auto &tile : candidate_tiles) {
+    area += tile.N;
+  }
+  if (area > params.N) {
+    return 0;
+  }
+  // The DLX search covers the empty cells with monominos, it can't tell
+  // them from the monominos among the pieces.
+  const bool has_monomino =
+      std::find(candidate_tiles.begin(), candidate_tiles.end(),
+                PolyominoSubsetIndex{1, 0}) != candidate_tiles.end();
+  if (algo == Algoritm::DLX && !(has_monomino && area < params.N)) {
+    std::vector<std::vector<std::size_t>> rows;
+    withPlacementRows(candidate_tiles, area, [&](DLMatrix &matrix) {
+      SolveCoverProblem(matrix, max_solutions, rows);
+    });
+    solutions.resize(rows.size());
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+      dlxSolution(candidate_tiles, rows[i], solutions[i]);
+    }
+    return solutions.size();
+  }
+  // BITSET has no search for several solutions, it goes to the BF search
+  // like its configurations that are too large. The search places every
+  // piece, so it can't break the symmetries of the board.
+  const BruteForceProblem problem(candidate_tiles, params.N,
+                                  newDeadStatesGeneration());
+  CellSearch search(params, candidate_tiles, problem.slack,
+                    problem.generation);
+  for (std::size_t t = 0; t < search.tiles.size(); ++t) {
+    search.by_cell.push_back(&placementsByCell(search.tiles[t]));
+  }
+  search.candidate_tiles = &candidate_tiles;
+  search.solutions = &solutions;
+  search.max_solutions = max_solutions;
+  cellSolve(search, 0);
+  return solutions.size();
+}
+
+Generator<std::vector<std::size_t>> PuzzleSolver::Solutions(
+    std::vector<PolyominoSubsetIndex> candidate_tiles) {
+  std::size_t area = 0;
+  for (const auto &tile : candidate_tiles) {
+    area += tile.N;
+  }
+  if (area > params.N) {
+    co_return;
+  }
+  // the CELLS search of SolveAtMost, without the dead ends, which other
+  // searches of the solver may change while this one is suspended
+  CellSearch search(params, candidate_tiles, params.N - area, 0);
+  for (std::size_t t = 0; t < search.tiles.size(); ++t) {
+    search.by_cell.push_back(&placementsByCell(search.tiles[t]));
+  }
+  std::vector<std::size_t> solution;
+  if (search.area == 0) {
+    co_yield solution;
+    co_return;
+  }
+  // A node branches on cell, its options are the placements
+  // (*by_cell[t])[cell][k] of every piece left and then leaving the cell
+  // empty. The option it took last is undone before it takes the next.
+  struct Node {
+    BitMaskType state;
+    std::size_t cell;
+    std::size_t t = 0;
+    std::size_t k = 0;
+    bool taken = false;
+    bool hole = false;
+  };
+  std::vector<Node> stack;
+  const auto push = [&](BitMaskType state) {
+    std::size_t num_options;
+    const std::size_t cell = branchingCell(search, state, num_options);
+    if (num_options > 0 && cellRegionsCanBeFilled(search, state)) {
+      stack.push_back(Node{state, cell});
+    }
+  };
+  push(0);
+  while (!stack.empty()) {
+    Node &node = stack.back();
+    if (node.taken) {
+      if (node.hole) {
+        ++search.holes;
+      } else {
+        ++search.remaining[node.t];
+        search.area += search.tiles[node.t].N;
+        search.placed.pop_back();
+      }
+      node.taken = false;
+    }
+    for (; node.t < search.tiles.size(); ++node.t, node.k = 0) {
+      if (search.remaining[node.t] == 0) {
+        continue;
+      }
+      const auto &masks = params[search.tiles[node.t]];
+      const auto &covering = (*search.by_cell[node.t])[node.cell];
+      while (node.k < covering.size() &&
+             (masks[covering[node.k]] & node.state) != 0) {
+        ++node.k;
+      }
+      if (node.k < covering.size()) {
+        node.taken = true;
+        break;
+      }
+    }
+    BitMaskType state;
+    if (node.taken) {
+      const std::size_t i = (*search.by_cell[node.t])[node.cell][node.k++];
+      --search.remaining[node.t];
+      search.area -= search.tiles[node.t].N;
+      search.placed.emplace_back(node.t, i);
+      state = node.state | params[search.tiles[node.t]][i];
+    } else if (search.holes > 0 && !node.hole) {
+      node.taken = true;
+      node.hole = true;
+      --search.holes;
+      state = node.state | BitMaskType{1} << node.cell;
+    } else {
+      stack.pop_back();
+      continue;
+    }
+    if (search.area == 0) {
+      InlineVector<std::pair<std::size_t, std::size_t>, kMaxPieces> placements;
+      for (const auto &[t, mask_idx] : search.placed) {
+        placements.emplace_back(search.tile_idx[t], mask_idx);
+      }
+      AssignPlacementsToCopies(candidate_tiles, placements, solution);
+      co_yield solution;
+    } else {
+      push(state);
+    }
+  }
+}
+
+template <bool kDecompose>
+bool PuzzleSolver::internalSolve(const BruteForceProblem &problem,
+                                 std::vector<std::size_t> &indices,
+                                 BitMaskType current_state,
+                                 std::size_t current_index) noexcept {
+  SearchStats::NodeScope node(search_stats);
+  const auto &candidate_tiles = problem.tiles;
   if (current_index == candidate_tiles.size()) {
     return true;
   }
@@ -196,20 +1104,418 @@ bool PuzzleSolver::internalSolve(
       candidate_tiles[current_index - 1] == candidate_tiles[current_index]) {
     start_offset = indices[current_index - 1] + 1;
   }
+  // the pieces still to place and where they may go only depend on these
+  const TranspositionTable<bool>::Key key{
+      current_state, current_index | uint64_t{start_offset} << 32};
+  if (problem.generation != 0 && dead_states->Find(key, problem.generation)) {
+    return false;
+  }
+  const BitMaskType full_mask = FullMask(params.N);
+  // decomposing pays off once at least two pieces are left
+  const bool decompose =
+      kDecompose && current_index + 2 < candidate_tiles.size();
+  bool stuck = true;
   for (std::size_t i = start_offset; i < cur_params.size(); ++i) {
     const auto mask = cur_params[i];
     if ((current_state & mask) != 0) {
       continue;
     }
+    const BitMaskType empty = full_mask & ~(current_state | mask);
+    std::size_t num_regions = 0;
+    if (options.prune_regions && current_index + 1 < candidate_tiles.size() &&
+        !params.RegionsCanBeFilled(empty,
+                                   problem.suffix_subset_sums[current_index + 1],
+                                   problem.suffix_area[current_index + 1],
+                                   problem.slack,
+                                   kDecompose ? &num_regions : nullptr)) {
+      continue;
+    }
+    stuck = false;
+    search_stats.AddChildren(1);
     indices[current_index] = i;
-    if (internalSolve(candidate_tiles, indices, current_state | mask,
-                      current_index + 1)) {
+    if (decompose &&
+        (options.prune_regions
+             ? num_regions > 1
+             : params.Region(empty, std::countr_zero(empty)) != empty)) {
+      if (solveRegions(problem, indices, current_state | mask,
+                       current_index + 1)) {
+        return true;
+      }
+    } else if (internalSolve<kDecompose>(problem, indices,
+                                         current_state | mask,
+                                         current_index + 1)) {
       return true;
     }
   }
+  if (stuck) {
+    search_stats.DeadEnd(current_index);
+  }
+  if (problem.generation != 0) {
+    dead_states->Store(key, problem.generation, true);
+  }
   return false;
 };
 
+bool PuzzleSolver::solveRegions(const BruteForceProblem &problem,
+                                std::vector<std::size_t> &indices,
+                                BitMaskType current_state,
+                                std::size_t current_index) noexcept {
+  SearchStats::NodeScope node(search_stats);
+  std::vector<BitMaskType> regions;
+  for (BitMaskType empty = FullMask(params.N) & ~current_state; empty != 0;
+       empty &= ~regions.back()) {
+    regions.push_back(params.Region(empty, std::countr_zero(empty)));
+  }
+  const auto &candidate_tiles = problem.tiles;
+  std::vector<PolyominoSubsetIndex> remaining(
+      candidate_tiles.begin() + current_index, candidate_tiles.end());
+  std::sort(remaining.begin(), remaining.end());
+  std::vector<std::pair<PolyominoSubsetIndex, std::size_t>> pieces_left;
+  for (const auto &tile : remaining) {
+    if (pieces_left.empty() || pieces_left.back().first != tile) {
+      pieces_left.emplace_back(tile, 0);
+    }
+    ++pieces_left.back().second;
+  }
+  // small regions first, few piece combinations fit into them
+  std::sort(regions.begin(), regions.end(), [](BitMaskType a, BitMaskType b) {
+    return std::popcount(a) < std::popcount(b);
+  });
+  RegionSplitter splitter(
+      regions, std::move(pieces_left), problem.slack,
+      [this](BitMaskType region,
+             const std::vector<PolyominoSubsetIndex> &pieces) {
+        return regionCanBePacked(region, pieces);
+      });
+  if (!splitter.Split()) {
+    search_stats.DeadEnd(current_index);
+    return false;
+  }
+  // The split only tells which pieces go where, solve every region once more
+  // for the placements and hand them out to the copies of the pieces.
+  std::vector<std::pair<PolyominoSubsetIndex, std::size_t>> placements;
+  for (std::size_t r = 0; r < regions.size(); ++r) {
+    const auto &pieces = splitter.pieces()[r];
+    const BruteForceProblem region_problem(
+        pieces, std::popcount(regions[r]), newDeadStatesGeneration());
+    std::vector<std::size_t> region_indices(pieces.size());
+    if (!internalSolve<true>(region_problem, region_indices,
+                             FullMask(params.N) & ~regions[r])) {
+      // regionCanBePacked answered from a cache entry that was wrong, e.g.
+      // a collision of the hashes of options.shared_cache
+      return false;
+    }
+    for (std::size_t i = 0; i < pieces.size(); ++i) {
+      placements.emplace_back(pieces[i], region_indices[i]);
+    }
+  }
+  std::sort(placements.begin(), placements.end());
+  for (std::size_t i = current_index; i < candidate_tiles.size(); ++i) {
+    const auto copy = std::count(candidate_tiles.begin() + current_index,
+                                 candidate_tiles.begin() + i,
+                                 candidate_tiles[i]);
+    const auto first = std::lower_bound(
+        placements.begin(), placements.end(),
+        std::make_pair(candidate_tiles[i], std::size_t{0}));
+    indices[i] = (first + copy)->second;
+  }
+  return true;
+}
+
+bool PuzzleSolver::cellSolve(CellSearch &search,
+                             BitMaskType current_state) noexcept {
+  SearchStats::NodeScope node(search_stats);
+  if (search.area == 0) {
+    if (search.solutions == nullptr) {
+      return true;
+    }
+    InlineVector<std::pair<std::size_t, std::size_t>, kMaxPieces> placements;
+    for (const auto &[t, mask_idx] : search.placed) {
+      placements.emplace_back(search.tile_idx[t], mask_idx);
+    }
+    AssignPlacementsToCopies(*search.candidate_tiles, placements,
+                             search.solutions->emplace_back());
+    return search.solutions->size() == search.max_solutions;
+  }
+  const TranspositionTable<bool>::Key key{current_state,
+                                          search.remaining_hash};
+  if (search.generation != 0 && dead_states->Find(key, search.generation)) {
+    return false;
+  }
+  // the empty cells and the pieces left decide, whatever configuration the
+  // state was reached from
+  const SolvabilityCache::Key shared_key{Mix(board_hash ^ Mix(current_state)),
+                                         search.remaining_hash};
+  if (options.shared_cache != nullptr &&
+      options.shared_cache->Find(shared_key) ==
+          SolvabilityCache::Result::UNSOLVABLE) {
+    return false;
+  }
+  const std::size_t num_solutions =
+      search.solutions != nullptr ? search.solutions->size() : 0;
+  if (!cellSolveChildren(search, current_state)) {
+    // SolveAtMost goes on after the solutions it collects
+    if (search.solutions != nullptr &&
+        search.solutions->size() != num_solutions) {
+      return false;
+    }
+    if (search.generation != 0) {
+      dead_states->Store(key, search.generation, true);
+    }
+    if (options.shared_cache != nullptr) {
+      options.shared_cache->Store(shared_key,
+                                  SolvabilityCache::Result::UNSOLVABLE);
+    }
+    return false;
+  }
+  return true;
+}
+
+bool PuzzleSolver::cellSolveSymmetric(CellSearch &search,
+                                      std::size_t t) noexcept {
+  SearchStats::NodeScope node(search_stats);
+  const auto &masks = params[search.tiles[t]];
+  const auto &classes = placementClasses(search.tiles[t]);
+  search_stats.AddChildren(classes.size());
+  --search.remaining[t];
+  search.area -= search.tiles[t].N;
+  search.remaining_hash -= search.tile_hash[t];
+  for (const auto &placement_class : classes) {
+    const std::size_t i = placement_class.first;
+    search.placed.emplace_back(t, i);
+    if (cellSolve(search, masks[i])) {
+      return true;
+    }
+    search.placed.pop_back();
+  }
+  ++search.remaining[t];
+  search.area += search.tiles[t].N;
+  search.remaining_hash += search.tile_hash[t];
+  return false;
+}
+
+bool PuzzleSolver::cellRegionsCanBeFilled(
+    const CellSearch &search, BitMaskType current_state) noexcept {
+  if (!options.prune_regions) {
+    return true;
+  }
+  uint64_t subset_sums = 1;
+  for (std::size_t t = 0; t < search.tiles.size(); ++t) {
+    for (std::size_t k = 0; k < search.remaining[t]; ++k) {
+      subset_sums |= subset_sums << search.tiles[t].N;
+    }
+  }
+  return params.RegionsCanBeFilled(FullMask(params.N) & ~current_state,
+                                   subset_sums, search.area, search.holes);
+}
+
+std::size_t
+PuzzleSolver::branchingCell(const CellSearch &search, BitMaskType current_state,
+                            std::size_t &best_options) noexcept {
+  const BitMaskType empty = FullMask(params.N) & ~current_state;
+  // the empty cell with the fewest placements covering it, leaving it empty
+  // counts as one more option while holes are left
+  std::size_t best_cell = 0;
+  best_options = std::numeric_limits<std::size_t>::max();
+  for (BitMaskType cells = empty; cells != 0 && best_options > 1;
+       cells &= cells - 1) {
+    const std::size_t cell = std::countr_zero(cells);
+    std::size_t num_options = search.holes > 0 ? 1 : 0;
+    for (std::size_t t = 0; t < search.tiles.size() && num_options < best_options;
+         ++t) {
+      if (search.remaining[t] == 0) {
+        continue;
+      }
+      const auto &masks = params[search.tiles[t]];
+      for (const auto i : (*search.by_cell[t])[cell]) {
+        num_options += (masks[i] & current_state) == 0;
+      }
+    }
+    if (num_options < best_options) {
+      best_options = num_options;
+      best_cell = cell;
+    }
+  }
+  return best_cell;
+}
+
+bool PuzzleSolver::cellSolveChildren(CellSearch &search,
+                                     BitMaskType current_state) noexcept {
+  if (!cellRegionsCanBeFilled(search, current_state)) {
+    return false;
+  }
+  std::size_t best_options;
+  const std::size_t best_cell =
+      branchingCell(search, current_state, best_options);
+  if (best_options == 0) {
+    search_stats.DeadEnd(best_cell);
+    return false;
+  }
+  search_stats.AddChildren(best_options);
+  for (std::size_t t = 0; t < search.tiles.size(); ++t) {
+    if (search.remaining[t] == 0) {
+      continue;
+    }
+    const auto &masks = params[search.tiles[t]];
+    --search.remaining[t];
+    search.area -= search.tiles[t].N;
+    search.remaining_hash -= search.tile_hash[t];
+    for (const auto i : (*search.by_cell[t])[best_cell]) {
+      if ((masks[i] & current_state) != 0) {
+        continue;
+      }
+      search.placed.emplace_back(t, i);
+      if (cellSolve(search, current_state | masks[i])) {
+        return true;
+      }
+      search.placed.pop_back();
+    }
+    ++search.remaining[t];
+    search.area += search.tiles[t].N;
+    search.remaining_hash += search.tile_hash[t];
+  }
+  if (search.holes > 0) {
+    --search.holes;
+    const bool solved =
+        cellSolve(search, current_state | BitMaskType{1} << best_cell);
+    ++search.holes;
+    return solved;
+  }
+  return false;
+}
+
+uint32_t PuzzleSolver::newDeadStatesGeneration() noexcept {
+  if (options.transposition_table_bits == 0) {
+    return 0;
+  }
+  if (!dead_states) {
+    dead_states = std::make_unique<TranspositionTable<bool>>(
+        options.transposition_table_bits);
+  }
+  return dead_states->NewGeneration();
+}
+
+const std::vector<std::vector<uint32_t>> &
+PuzzleSolver::placementsByCell(PolyominoSubsetIndex tile) noexcept {
+  auto it = cell_placements.find(tile);
+  if (it == cell_placements.end()) {
+    std::vector<std::vector<uint32_t>> by_cell(params.N);
+    const auto &masks = params[tile];
+    for (uint32_t i = 0; i < masks.size(); ++i) {
+      for (BitMaskType bits = masks[i]; bits != 0; bits &= bits - 1) {
+        by_cell[std::countr_zero(bits)].push_back(i);
+      }
+    }
+    it = cell_placements.emplace(tile, std::move(by_cell)).first;
+  }
+  return it->second;
+}
+
+const std::vector<std::pair<uint32_t, uint32_t>> &
+PuzzleSolver::placementClasses(PolyominoSubsetIndex tile) noexcept {
+  auto it = placement_classes.find(tile);
+  if (it != placement_classes.end()) {
+    return it->second;
+  }
+  std::vector<std::pair<uint32_t, uint32_t>> classes;
+  const auto &masks = params[tile];
+  std::vector<BitMaskType> sorted_masks(masks.begin(), masks.end());
+  std::sort(sorted_masks.begin(), sorted_masks.end());
+  bool closed = true;
+  for (uint32_t i = 0; i < masks.size() && closed; ++i) {
+    std::vector<BitMaskType> images;
+    for (std::size_t g = 0; g < params.automorphisms.size(); ++g) {
+      images.push_back(params.Permute(masks[i], g));
+    }
+    std::sort(images.begin(), images.end());
+    images.erase(std::unique(images.begin(), images.end()), images.end());
+    // the placements of a piece include all its rotations and reflections,
+    // so this only fails if the masks of the piece were incomplete
+    closed = std::all_of(images.begin(), images.end(), [&](BitMaskType m) {
+      return std::binary_search(sorted_masks.begin(), sorted_masks.end(), m);
+    });
+    if (images.front() == masks[i]) {
+      classes.emplace_back(i, images.size());
+    }
+  }
+  if (!closed || params.automorphisms.size() <= 1) {
+    classes.clear();
+  }
+  return placement_classes.emplace(tile, std::move(classes)).first->second;
+}
+
+bool PuzzleSolver::regionCanBePacked(
+    BitMaskType region,
+    const std::vector<PolyominoSubsetIndex> &pieces) noexcept {
+  if (pieces.empty()) {
+    return true;
+  }
+  std::string key = regionShape(region);
+  appendPieces(key, pieces);
+  if (const auto it = region_cache.find(key); it != region_cache.end()) {
+    return it->second;
+  }
+  // the key has no board in it, regions of the same shape on other boards
+  // share the entry
+  const SolvabilityCache::Key shared_key{HashBytes(key, 1), HashBytes(key, 2)};
+  if (options.shared_cache != nullptr) {
+    const auto shared = options.shared_cache->Find(shared_key);
+    if (shared != SolvabilityCache::Result::UNKNOWN) {
+      const bool result = shared == SolvabilityCache::Result::SOLVABLE;
+      cacheRegionResult(std::move(key), result);
+      return result;
+    }
+  }
+  const BruteForceProblem problem(pieces, std::popcount(region),
+                                  newDeadStatesGeneration());
+  std::vector<std::size_t> indices(pieces.size());
+  const bool result =
+      problem.fits &&
+      internalSolve<true>(problem, indices, FullMask(params.N) & ~region);
+  if (options.shared_cache != nullptr) {
+    options.shared_cache->Store(shared_key,
+                                result ? SolvabilityCache::Result::SOLVABLE
+                                       : SolvabilityCache::Result::UNSOLVABLE);
+  }
+  cacheRegionResult(std::move(key), result);
+  return result;
+}
+
+const std::string &PuzzleSolver::regionShape(BitMaskType region) noexcept {
+  auto shape = region_shapes.find(region);
+  if (shape == region_shapes.end()) {
+    if (region_shapes.size() >= kMaxRegionCacheSize) {
+      region_shapes.clear();
+    }
+    shape =
+        region_shapes.emplace(region, CanonicalRegion(params, region)).first;
+  }
+  return shape->second;
+}
+
+void PuzzleSolver::appendPieces(
+    std::string &key,
+    const std::vector<PolyominoSubsetIndex> &pieces) const noexcept {
+  // The pieces are sorted, and subset indices are ordered like the global
+  // indices of the polyominos. Shapes only use bytes below 64, so the
+  // separator ends them.
+  key.push_back('|');
+  for (const auto &tile : pieces) {
+    const auto shape =
+        params.possible_tiles_per_size[tile.N - 1][tile.index].polyomino_index;
+    key.push_back(shape.N);
+    key.push_back(shape.index & 0xff);
+    key.push_back(shape.index >> 8);
+  }
+}
+
+void PuzzleSolver::cacheRegionResult(std::string key, bool result) noexcept {
+  if (region_cache.size() >= kMaxRegionCacheSize) {
+    region_cache.clear();
+  }
+  region_cache.emplace(std::move(key), result);
+}
+
 // double PuzzleSolver::EstimateDifficulty(
 //     const std::vector<PolyominoSubsetIndex> &candidate_tiles,
 //     Algoritm algo) const noexcept {
@@ -286,72 +1592,369 @@ bool PuzzleSolver::internalSolve(
 
 double PuzzleSolver::EstimateDifficulty(
     const std::vector<PolyominoSubsetIndex> &candidate_tiles,
-    Algoritm algo) const noexcept {
-
-  const auto calc_difficulty =
-      [&params =
-           params](const std::vector<PolyominoSubsetIndex> &candidate_tiles,
-                   uint64_t num_before_solution_cutoff =
-                       std::numeric_limits<uint64_t>::max()) {
-        uint64_t num_before_solution = 0;
-        uint64_t num_solutions = 0;
-        std::vector<std::size_t> previous_dup_elem(candidate_tiles.size(), 0);
-        for (std::size_t i = 1; i < candidate_tiles.size(); ++i) {
-          for (std::size_t j = 0; j < i; ++j) {
-            if (candidate_tiles[j] == candidate_tiles[i]) {
-              previous_dup_elem[i] = j;
-            }
-          }
-        }
-        std::vector<std::size_t> indices(candidate_tiles.size());
-        auto walkSolutions = [&](auto &&self, BitMaskType current_state,
-                                 std::size_t current_index) -> void {
-          const auto &cur_params = params[candidate_tiles[current_index]];
-          uint64_t start_offset = 0;
-          if (previous_dup_elem[current_index] != 0) {
-            start_offset = indices[previous_dup_elem[current_index]] + 1;
-          }
-          if (current_index == candidate_tiles.size() - 1) {
-            ++num_before_solution;
-          }
-          if (num_before_solution > num_before_solution_cutoff) {
-            return;
-          }
-          for (std::size_t i = start_offset; i < cur_params.size(); ++i) {
-            const auto mask = cur_params[i];
-            if ((current_state & mask) != 0) {
-              continue;
-            }
-            if (current_index == candidate_tiles.size() - 1) {
-              ++num_solutions;
-            } else {
-              indices[current_index] = i;
-              self(self, current_state | mask, current_index + 1);
-              if (num_before_solution > num_before_solution_cutoff) {
-                return;
-              }
-            }
-          }
-        };
-        walkSolutions(walkSolutions, 0, 0);
-        return std::make_pair(num_before_solution, num_solutions);
-      };
+    Algoritm algo, SolutionCounts *solutions) noexcept {
+  // A search placing the pieces one after the other goes through all
+  // positions of all but its last piece before it can tell which of them
+  // lead to solutions. The difficulty is the fewest such positions over the
+  // choices of the last piece, they only depend on which piece it is.
+  //
+  // All of them and the solutions are counted by one search that places the
+  // pieces piece by piece in the order of their first appearance, the copies
+  // of a piece in increasing order of their placements. It counts the ways to
+  // place the remaining pieces from a state, keyed by the occupied cells and
+  // the remaining pieces. Once the piece left out has been placed, the
+  // remaining pieces are the same for every choice of it. The occupied
+  // cells only agree between choices of pieces of the same size, these
+  // share the counts of the subtrees below.
+  if (candidate_tiles.empty()) {
+    if (solutions != nullptr) {
+      *solutions = {.raw = 1, .up_to_symmetry = 1};
+    }
+    return 0;
+  }
+  if (options.transposition_table_bits != 0 && !subtree_counts) {
+    subtree_counts = std::make_unique<TranspositionTable<uint64_t>>(
+        options.transposition_table_bits);
+  }
+  auto &buf = buffers();
+  // distinct pieces and how often they appear
+  auto &pieces = buf.pieces;
+  pieces.clear();
+  for (const auto &tile : candidate_tiles) {
+    const auto it = std::find_if(pieces.begin(), pieces.end(),
+                                 [&](const auto &p) { return p.first == tile; });
+    if (it == pieces.end()) {
+      pieces.emplace_back(tile, 1);
+    } else {
+      ++it->second;
+    }
+  }
+  // On a symmetric board the first piece, if it appears once, is only placed
+  // at one placement of every class of symmetric placements. The placements
+  // of a class have the same number of ways to place the other pieces, so
+  // these count as many times as the class has placements.
+  const std::vector<std::pair<uint32_t, uint32_t>> *root_classes = nullptr;
+  if (options.break_symmetries && params.automorphisms.size() > 1) {
+    std::size_t root = pieces.size();
+    for (std::size_t i = 0; i < pieces.size(); ++i) {
+      if (pieces[i].second != 1) {
+        continue;
+      }
+      const auto &classes = placementClasses(pieces[i].first);
+      if (!classes.empty() &&
+          (root_classes == nullptr || classes.size() < root_classes->size())) {
+        root = i;
+        root_classes = &classes;
+      }
+    }
+    if (root_classes != nullptr) {
+      std::rotate(pieces.begin(), pieces.begin() + root,
+                  pieces.begin() + root + 1);
+    }
+  }
+  TranspositionTable<uint64_t> *const table = subtree_counts.get();
+  const uint32_t generation = table ? table->NewGeneration() : 0;
+  // Counts stop as soon as they exceed cutoff, the fewest positions found
+  // so far.
+  uint64_t cutoff = std::numeric_limits<uint64_t>::max();
+  using Count = DifficultyCount;
+  const auto copies = [&](const Count &run, std::size_t piece) {
+    return pieces[piece].second - (piece == run.left_out ? 1 : 0);
+  };
+  const auto next_piece = [&](const Count &run, std::size_t piece) {
+    while (piece < pieces.size() && copies(run, piece) == 0) {
+      ++piece;
+    }
+    return piece;
+  };
+  // Ways to place the remaining copies of piece, the first of them at a
+  // placement from start on, and all pieces after it. Returns 0 once the
+  // count is cut off.
+  const auto count = [&](auto &&self, Count &run, BitMaskType current_state,
+                         std::size_t piece, std::size_t copies_left,
+                         std::size_t start, std::size_t depth) -> uint64_t {
+    SearchStats::NodeScope node(run.stats);
+    // the remaining pieces besides the copies of piece are those after it,
+    // less the one left out if it comes later, the same as leaving none out
+    // otherwise
+    const std::size_t later_left_out =
+        run.left_out > piece ? run.left_out : pieces.size();
+    const TranspositionTable<uint64_t>::Key key{
+        current_state, piece | copies_left << 16 | start << 32 |
+                           uint64_t{later_left_out} << 48};
+    if (table != nullptr) {
+      if (const auto counted = table->Find(key, generation)) {
+        run.counted += *counted;
+        return *counted;
+      }
+    }
+    const auto &masks = params[pieces[piece].first];
+    const bool symmetric_root =
+        depth == 0 && piece == 0 && root_classes != nullptr;
+    const std::size_t num_children =
+        symmetric_root ? root_classes->size() : masks.size();
+    uint64_t result = 0;
+    for (std::size_t c = start; c < num_children; ++c) {
+      const std::size_t i = symmetric_root ? (*root_classes)[c].first : c;
+      const uint64_t weight = symmetric_root ? (*root_classes)[c].second : 1;
+      if ((current_state & masks[i]) != 0) {
+        continue;
+      }
+      run.stats.AddChildren(1);
+      const BitMaskType state = current_state | masks[i];
+      uint64_t ways = 1;
+      if (copies_left > 1) {
+        ways =
+            self(self, run, state, piece, copies_left - 1, i + 1, depth + 1);
+      } else if (const std::size_t next = next_piece(run, piece + 1);
+                 next < pieces.size()) {
+        ways = self(self, run, state, next, copies(run, next), 0, depth + 1);
+      } else {
+        ++run.counted;
+      }
+      result += weight * ways;
+      run.counted += (weight - 1) * ways;
+      if (run.counted > cutoff) {
+        run.cut_off = true;
+      }
+      if (run.cut_off) {
+        return 0;
+      }
+    }
+    if (result == 0) {
+      run.stats.DeadEnd(depth);
+    }
+    if (table != nullptr) {
+      table->Store(key, generation, result);
+    }
+    return result;
+  };
+  const auto count_all = [&](Count &run) {
+    if (const std::size_t first = next_piece(run, 0); first < pieces.size()) {
+      count(count, run, 0, first, copies(run, first), 0, 0);
+    } else {
+      run.counted = 1;
+    }
+    if (!run.cut_off) {
+      cutoff = std::min(cutoff, run.counted);
+    }
+  };
 
-  std::vector<PolyominoSubsetIndex> c = candidate_tiles;
-  auto [num_before_solution, num_solutions] = calc_difficulty(c);
+  Count all_pieces{.left_out = pieces.size()};
+  count_all(all_pieces);
+  search_stats.Merge(all_pieces.stats);
+  const uint64_t num_solutions = all_pieces.counted;
+  cutoff = std::numeric_limits<uint64_t>::max();
 
-  for (std::size_t i = 1; i < c.size(); ++i) {
-    std::rotate(c.begin(), c.begin() + 1, c.end());
-    num_before_solution = std::min(
-        num_before_solution, calc_difficulty(c, num_before_solution).first);
+  auto &left_out = buf.left_out;
+  left_out.resize(pieces.size());
+  for (std::size_t i = 0; i < pieces.size(); ++i) {
+    left_out[i] = Count{.left_out = i};
+  }
+  for (auto &run : left_out) {
+    count_all(run);
+  }
+  for (const auto &run : left_out) {
+    search_stats.Merge(run.stats);
+  }
+  const uint64_t num_before_solution = cutoff;
+  if (solutions != nullptr) {
+    // Burnside: the classes of solutions under the symmetries are the
+    // average number of solutions a symmetry maps onto themselves
+    uint64_t fixed = num_solutions;
+    for (std::size_t g = 1; g < params.automorphisms.size(); ++g) {
+      fixed += countSymmetricSolutions(pieces, g);
+    }
+    *solutions = {.raw = num_solutions,
+                  .up_to_symmetry = fixed / params.automorphisms.size()};
   }
   return std::log2(num_before_solution) - std::log(num_solutions);
-};
+}
 
-std::vector<BitMaskType> CrossProduct(const std::vector<BitMaskType> &a,
-                                      const std::vector<BitMaskType> &b) {
-  std::vector<BitMaskType> result;
-  result.reserve(a.size() * b.size());
+DifficultyEstimate PuzzleSolver::SampleDifficulty(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+    const SamplingOptions &sampling) noexcept {
+  DifficultyEstimate result;
+  std::size_t area = 0;
+  for (const auto &tile : candidate_tiles) {
+    area += tile.N;
+  }
+  if (area > params.N) {
+    return result;
+  }
+  // the pieces and their copies in the order of EstimateDifficulty
+  InlineVector<std::pair<PolyominoSubsetIndex, std::size_t>, kMaxPieces>
+      pieces;
+  for (const auto &tile : candidate_tiles) {
+    const auto it = std::find_if(pieces.begin(), pieces.end(),
+                                 [&](const auto &p) { return p.first == tile; });
+    if (it == pieces.end()) {
+      pieces.emplace_back(tile, 1);
+    } else {
+      ++it->second;
+    }
+  }
+  const std::size_t width =
+      std::clamp<std::size_t>(sampling.width, 1, kMaxProbeWidth);
+  std::mt19937_64 rng(sampling.seed);
+  const auto copies = [&](std::size_t left_out, std::size_t piece) {
+    return pieces[piece].second - (piece == left_out ? 1 : 0);
+  };
+  const auto next_piece = [&](std::size_t left_out, std::size_t piece) {
+    while (piece < pieces.size() && copies(left_out, piece) == 0) {
+      ++piece;
+    }
+    return piece;
+  };
+  // Estimate of the ways to place the remaining copies of piece, the first
+  // at a placement from start on, and all pieces after it: the number of
+  // children times the mean of the estimates of up to width of them, picked
+  // at random.
+  const auto probe = [&](auto &&self, std::size_t left_out,
+                         BitMaskType current_state, std::size_t piece,
+                         std::size_t copies_left,
+                         std::size_t start) -> double {
+    ++result.nodes;
+    const auto &masks = params[pieces[piece].first];
+    // reservoir sample of the children
+    InlineVector<uint32_t, kMaxProbeWidth> picked;
+    std::size_t num_children = 0;
+    for (std::size_t i = start; i < masks.size(); ++i) {
+      if ((current_state & masks[i]) != 0) {
+        continue;
+      }
+      if (picked.size() < width) {
+        picked.push_back(i);
+      } else if (const std::size_t j = rng() % (num_children + 1);
+                 j < width) {
+        picked[j] = i;
+      }
+      ++num_children;
+    }
+    double sum = 0;
+    for (const auto i : picked) {
+      const BitMaskType state = current_state | masks[i];
+      if (copies_left > 1) {
+        sum += self(self, left_out, state, piece, copies_left - 1, i + 1);
+      } else if (const std::size_t next = next_piece(left_out, piece + 1);
+                 next < pieces.size()) {
+        sum += self(self, left_out, state, next, copies(left_out, next), 0);
+      } else {
+        sum += 1;
+      }
+    }
+    return picked.empty() ? 0 : sum * num_children / picked.size();
+  };
+  const auto sample = [&](std::size_t left_out) {
+    const std::size_t first = next_piece(left_out, 0);
+    if (first == pieces.size()) {
+      return SampledCount{1, 1, 1};
+    }
+    double sum = 0;
+    double sum_of_squares = 0;
+    for (std::size_t i = 0; i < sampling.probes; ++i) {
+      const double x =
+          probe(probe, left_out, 0, first, copies(left_out, first), 0);
+      sum += x;
+      sum_of_squares += x * x;
+    }
+    const double n = std::max<std::size_t>(sampling.probes, 1);
+    const double mean = sum / n;
+    const double variance =
+        n > 1 ? std::max(0.0, (sum_of_squares - n * mean * mean) / (n - 1))
+              : 0.0;
+    const double margin = sampling.z * std::sqrt(variance / n);
+    return SampledCount{mean, std::max(0.0, mean - margin), mean + margin};
+  };
+
+  result.solutions = sample(pieces.size());
+  result.positions = sample(0);
+  for (std::size_t i = 1; i < pieces.size(); ++i) {
+    const SampledCount positions = sample(i);
+    if (positions.mean < result.positions.mean) {
+      result.positions = positions;
+    }
+  }
+  // counts of configurations with a solution are at least 1
+  const auto log2_count = [](double count) {
+    return std::log2(std::max(count, 1.0));
+  };
+  const auto log_count = [](double count) {
+    return std::log(std::max(count, 1.0));
+  };
+  result.difficulty = log2_count(result.positions.mean) -
+                      log_count(result.solutions.mean);
+  result.low =
+      log2_count(result.positions.low) - log_count(result.solutions.high);
+  result.high =
+      log2_count(result.positions.high) - log_count(result.solutions.low);
+  return result;
+}
+
+uint64_t PuzzleSolver::countSymmetricSolutions(
+    const std::vector<std::pair<PolyominoSubsetIndex, std::size_t>> &pieces,
+    std::size_t automorphism) noexcept {
+  // A solution the automorphism maps onto itself consists of whole orbits of
+  // placements: the placements of a piece that repeated application of the
+  // automorphism goes through, if they don't overlap. Counts the choices of
+  // non-overlapping orbits, for every piece with as many placements as it
+  // has copies.
+  struct Orbit {
+    BitMaskType cells;
+    std::size_t size;
+  };
+  std::vector<std::vector<Orbit>> orbits(pieces.size());
+  for (std::size_t k = 0; k < pieces.size(); ++k) {
+    const auto &masks = params[pieces[k].first];
+    std::vector<BitMaskType> sorted_masks(masks.begin(), masks.end());
+    std::sort(sorted_masks.begin(), sorted_masks.end());
+    for (const BitMaskType mask : masks) {
+      Orbit orbit{mask, 1};
+      bool valid = true;
+      for (BitMaskType image = params.Permute(mask, automorphism);
+           image != mask && valid;
+           image = params.Permute(image, automorphism)) {
+        // listed once, by its smallest placement
+        valid = image > mask && (orbit.cells & image) == 0 &&
+                std::binary_search(sorted_masks.begin(), sorted_masks.end(),
+                                   image);
+        orbit.cells |= image;
+        ++orbit.size;
+      }
+      if (valid && orbit.size <= pieces[k].second) {
+        orbits[k].push_back(orbit);
+      }
+    }
+  }
+  const auto count = [&](auto &&self, BitMaskType state, std::size_t k,
+                         std::size_t copies_left,
+                         std::size_t start) -> uint64_t {
+    uint64_t result = 0;
+    for (std::size_t j = start; j < orbits[k].size(); ++j) {
+      const auto &orbit = orbits[k][j];
+      if (orbit.size > copies_left || (state & orbit.cells) != 0) {
+        continue;
+      }
+      const BitMaskType next_state = state | orbit.cells;
+      if (orbit.size < copies_left) {
+        result += self(self, next_state, k, copies_left - orbit.size, j + 1);
+      } else if (k + 1 < pieces.size()) {
+        result += self(self, next_state, k + 1, pieces[k + 1].second, 0);
+      } else {
+        ++result;
+      }
+    }
+    return result;
+  };
+  return count(count, 0, 0, pieces[0].second, 0);
+}
+
+// CrossProduct into result, reusing its memory
+void CrossProduct(const std::vector<BitMaskType> &a,
+                  const std::vector<BitMaskType> &b,
+                  std::vector<BitMaskType> &result) {
+  result.clear();
+  result.reserve(std::min(a.size() * b.size(), kMaxCrossProductReserve));
   for (const auto &x : a) {
     for (const auto &y : b) {
       if ((x & y) == 0) {
@@ -361,6 +1964,358 @@ std::vector<BitMaskType> CrossProduct(const std::vector<BitMaskType> &a,
   }
   std::sort(result.begin(), result.end());
   result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+void CrossProduct(const std::vector<BitMaskType> &a,
+                  const std::vector<BitMaskType> &b,
+                  std::vector<uint64_t> &seen,
+                  std::vector<BitMaskType> &result) {
+  result.clear();
+  for (const auto &x : a) {
+    for (const auto &y : b) {
+      if ((x & y) != 0) {
+        continue;
+      }
+      const BitMaskType cells = x | y;
+      uint64_t &word = seen[cells >> 6];
+      const uint64_t bit = uint64_t{1} << (cells & 63);
+      if ((word & bit) == 0) {
+        word |= bit;
+        result.push_back(cells);
+      }
+    }
+  }
+  for (const auto cells : result) {
+    seen[cells >> 6] &= ~(uint64_t{1} << (cells & 63));
+  }
+  std::sort(result.begin(), result.end());
+}
+
+std::vector<BitMaskType> CrossProduct(const std::vector<BitMaskType> &a,
+                                      const std::vector<BitMaskType> &b) {
+  std::vector<BitMaskType> result;
+  CrossProduct(a, b, result);
+  return result;
+}
+
+PrefixSolver::PrefixSolver(const PuzzleParams &params)
+    : params(params), states(1, std::vector<BitMaskType>{0}),
+      empty_sets(std::max<std::size_t>(1, (std::size_t{1} << params.N) / 64)),
+      seen(empty_sets.size()) {
+  assert(params.N <= kMaxCells);
+  updateEmptySets();
+}
+
+void PrefixSolver::SetPrefix(
+    const std::vector<PolyominoSubsetIndex> &new_prefix) {
+  std::size_t common = 0;
+  while (common < prefix.size() && common < new_prefix.size() &&
+         prefix[common] == new_prefix[common]) {
+    ++common;
+  }
+  if (common == prefix.size() && common == new_prefix.size()) {
+    return;
+  }
+  prefix.resize(common);
+  for (std::size_t i = common; i < new_prefix.size(); ++i) {
+    prefix.push_back(new_prefix[i]);
+    if (states.size() == i + 1) {
+      states.emplace_back();
+    }
+    CrossProduct(states[i], params[new_prefix[i]], seen, states[i + 1]);
+  }
+  updateEmptySets();
+}
+
+void PrefixSolver::updateEmptySets() {
+  std::fill(empty_sets.begin(), empty_sets.end(), 0);
+  const BitMaskType board = (BitMaskType{1} << params.N) - 1;
+  for (const auto state : states[prefix.size()]) {
+    const BitMaskType empty = board & ~state;
+    empty_sets[empty >> 6] |= uint64_t{1} << (empty & 63);
+  }
+  // close under subsets: with x also x without cell i, for every cell
+  constexpr std::array<uint64_t, 6> kWithBit = {
+      0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+      0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL};
+  for (std::size_t i = 0; i < params.N; ++i) {
+    if (i < 6) {
+      for (auto &word : empty_sets) {
+        word |= (word & kWithBit[i]) >> (1 << i);
+      }
+    } else {
+      const std::size_t stride = std::size_t{1} << (i - 6);
+      for (std::size_t j = 0; j < empty_sets.size(); ++j) {
+        if (j & stride) {
+          empty_sets[j ^ stride] |= empty_sets[j];
+        }
+      }
+    }
+  }
+}
+
+bool PrefixSolver::Solve(const std::vector<PolyominoSubsetIndex> &suffix) {
+  indices.resize(suffix.size());
+  return solveSuffix(suffix, 0, 0);
+}
+
+bool PrefixSolver::solveSuffix(const std::vector<PolyominoSubsetIndex> &suffix,
+                               BitMaskType current_state,
+                               std::size_t current_index) {
+  if (current_index == suffix.size()) {
+    return true;
+  }
+  const auto &masks = params[suffix[current_index]];
+  // copies of a piece are placed in increasing order
+  const std::size_t start =
+      current_index > 0 && suffix[current_index - 1] == suffix[current_index]
+          ? indices[current_index - 1] + 1
+          : 0;
+  for (std::size_t i = start; i < masks.size(); ++i) {
+    const BitMaskType state = current_state | masks[i];
+    if ((current_state & masks[i]) != 0 || !canStayEmpty(state)) {
+      continue;
+    }
+    indices[current_index] = i;
+    if (solveSuffix(suffix, state, current_index + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+MeetInTheMiddleSolver::MeetInTheMiddleSolver(const PuzzleParams &params)
+    : params(params), board(FullMask(params.N)),
+      seen(std::max<std::size_t>(1, (std::size_t{1} << params.N) / 64)) {
+  assert(params.N <= kMaxCells);
+  for (std::size_t cell = 0; cell < params.N; ++cell) {
+    cells.push_back(BitMaskType{1} << cell);
+  }
+}
+
+bool MeetInTheMiddleSolver::split(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles) {
+  std::size_t area = 0;
+  for (const auto &tile : candidate_tiles) {
+    area += tile.N;
+  }
+  if (area > params.N) {
+    return false;
+  }
+  std::vector<Group> groups;
+  for (std::size_t i = 0; i < candidate_tiles.size(); ++i) {
+    const auto it = std::find_if(groups.begin(), groups.end(), [&](const auto &g) {
+      return g.first < candidate_tiles.size() &&
+             candidate_tiles[g.first] == candidate_tiles[i];
+    });
+    if (it == groups.end()) {
+      groups.push_back(Group{&params[candidate_tiles[i]], 1, i});
+    } else {
+      ++it->copies;
+    }
+  }
+  if (area < params.N) {
+    groups.push_back(Group{&cells, params.N - area, candidate_tiles.size()});
+  }
+  // natural log of the ways to place the copies of a group on the empty
+  // board
+  const auto weight = [](const Group &g) {
+    return std::lgamma(g.masks->size() + 1.0) - std::lgamma(g.copies + 1.0) -
+           std::lgamma(g.masks->size() - g.copies + 1.0);
+  };
+  std::sort(groups.begin(), groups.end(),
+            [&](const auto &a, const auto &b) { return weight(a) > weight(b); });
+  // the heaviest groups first into the lighter half
+  std::array<double, 2> weights{};
+  halves[0].clear();
+  halves[1].clear();
+  for (const auto &g : groups) {
+    const std::size_t h = weights[1] < weights[0] ? 1 : 0;
+    halves[h].push_back(g);
+    weights[h] += weight(g);
+  }
+  // the empty cells in the first half
+  if (area < params.N &&
+      std::any_of(halves[1].begin(), halves[1].end(), [&](const auto &g) {
+        return g.first == candidate_tiles.size();
+      })) {
+    std::swap(halves[0], halves[1]);
+  }
+  const auto add = [&](Rest &r, const Group &g) {
+    for (std::size_t copy = 0; copy < g.copies; ++copy) {
+      if (g.masks == &cells) {
+        ++r.holes;
+      } else {
+        const std::size_t size = candidate_tiles[g.first].N;
+        r.subset_sums |= r.subset_sums << size;
+        r.area += size;
+      }
+    }
+  };
+  for (std::size_t h = 0; h < 2; ++h) {
+    Rest r{1, 0, 0};
+    for (const auto &g : halves[1 - h]) {
+      add(r, g);
+    }
+    // backwards from the last copy of the half
+    rest[h].assign(1, r);
+    for (auto g = halves[h].rbegin(); g != halves[h].rend(); ++g) {
+      for (std::size_t copy = 0; copy < g->copies; ++copy) {
+        add(r, Group{g->masks, 1, g->first});
+        rest[h].push_back(r);
+      }
+    }
+    std::reverse(rest[h].begin(), rest[h].end());
+  }
+  return true;
+}
+
+bool MeetInTheMiddleSolver::Solve(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+    std::vector<std::size_t> &solution) {
+  solution.clear();
+  if (!split(candidate_tiles)) {
+    return false;
+  }
+  for (std::size_t h = 0; h < 2; ++h) {
+    auto &level = levels[h];
+    std::size_t i = 0;
+    if (level.empty()) {
+      level.emplace_back();
+    }
+    level[0].assign(1, 0);
+    for (const auto &g : halves[h]) {
+      for (std::size_t copy = 0; copy < g.copies; ++copy, ++i) {
+        if (level.size() == i + 1) {
+          level.emplace_back();
+        }
+        CrossProduct(level[i], *g.masks, seen, level[i + 1]);
+        auto &next = level[i + 1];
+        next.erase(std::remove_if(next.begin(), next.end(),
+                                  [&](BitMaskType covered) {
+                                    return !canComplete(h, i + 1, covered);
+                                  }),
+                   next.end());
+      }
+    }
+  }
+  const auto last = [&](std::size_t h) -> const std::vector<BitMaskType> & {
+    std::size_t copies = 0;
+    for (const auto &g : halves[h]) {
+      copies += g.copies;
+    }
+    return levels[h][copies];
+  };
+  const auto &first_half = last(0);
+  const auto &second_half = last(1);
+  for (const auto covered : first_half) {
+    if (!std::binary_search(second_half.begin(), second_half.end(),
+                            board & ~covered)) {
+      continue;
+    }
+    std::vector<std::pair<std::size_t, std::size_t>> placements;
+    reconstruct(0, covered, placements);
+    reconstruct(1, board & ~covered, placements);
+    AssignPlacementsToCopies(candidate_tiles, placements, solution);
+    return true;
+  }
+  return false;
+}
+
+void MeetInTheMiddleSolver::reconstruct(
+    std::size_t h, BitMaskType covered,
+    std::vector<std::pair<std::size_t, std::size_t>> &placements) const {
+  std::size_t i = 0;
+  for (const auto &g : halves[h]) {
+    i += g.copies;
+  }
+  // the last copy first: one of its placements leaves cells the copies
+  // before it can cover
+  for (auto g = halves[h].rbegin(); g != halves[h].rend(); ++g) {
+    for (std::size_t copy = 0; copy < g->copies; ++copy, --i) {
+      const auto &masks = *g->masks;
+      const auto &before = levels[h][i - 1];
+      for (std::size_t j = 0; j < masks.size(); ++j) {
+        if ((masks[j] & ~covered) == 0 &&
+            std::binary_search(before.begin(), before.end(),
+                               covered & ~masks[j])) {
+          covered &= ~masks[j];
+          if (g->masks != &cells) {
+            placements.emplace_back(g->first, j);
+          }
+          break;
+        }
+      }
+    }
+  }
+}
+
+uint64_t MeetInTheMiddleSolver::CountSolutions(
+    const std::vector<PolyominoSubsetIndex> &candidate_tiles) {
+  if (!split(candidate_tiles)) {
+    return 0;
+  }
+  // (covered cells, ways to cover them) of both halves, sorted. The copies
+  // of a piece take their placements in increasing order, so the states
+  // within a group also remember where the next copy starts.
+  using Ways = std::vector<std::pair<BitMaskType, uint64_t>>;
+  std::array<Ways, 2> ways;
+  std::vector<std::tuple<BitMaskType, std::size_t, uint64_t>> current, next;
+  const auto merge = [](auto &states) {
+    std::sort(states.begin(), states.end());
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < states.size(); ++i) {
+      if (size > 0 && std::get<0>(states[size - 1]) == std::get<0>(states[i]) &&
+          std::get<1>(states[size - 1]) == std::get<1>(states[i])) {
+        std::get<2>(states[size - 1]) += std::get<2>(states[i]);
+      } else {
+        states[size++] = states[i];
+      }
+    }
+    states.resize(size);
+  };
+  for (std::size_t h = 0; h < 2; ++h) {
+    current.assign(1, {0, 0, 1});
+    std::size_t i = 0;
+    for (const auto &g : halves[h]) {
+      const auto &masks = *g.masks;
+      for (std::size_t copy = 0; copy < g.copies; ++copy, ++i) {
+        next.clear();
+        for (const auto &[covered, start, count] : current) {
+          for (std::size_t j = start; j < masks.size(); ++j) {
+            if ((covered & masks[j]) == 0) {
+              next.emplace_back(covered | masks[j], j + 1, count);
+            }
+          }
+        }
+        merge(next);
+        next.erase(std::remove_if(next.begin(), next.end(),
+                                  [&](const auto &state) {
+                                    return !canComplete(h, i + 1,
+                                                        std::get<0>(state));
+                                  }),
+                   next.end());
+        std::swap(current, next);
+      }
+      // the next group starts from its first placement
+      for (auto &state : current) {
+        std::get<1>(state) = 0;
+      }
+      merge(current);
+    }
+    for (const auto &[covered, start, count] : current) {
+      ways[h].emplace_back(covered, count);
+    }
+  }
+  uint64_t result = 0;
+  for (const auto &[covered, count] : ways[0]) {
+    const auto it = std::lower_bound(
+        ways[1].begin(), ways[1].end(),
+        std::make_pair(board & ~covered, uint64_t{0}));
+    if (it != ways[1].end() && it->first == (board & ~covered)) {
+      result += count * it->second;
+    }
+  }
   return result;
 }
 
@@ -1,6 +1,13 @@
 #pragma once
 #include "avx_match.hpp"
+#include "dl_matrix.hpp"
+#include "generator.hpp"
+#include "inline_vector.hpp"
 #include "polyominos.hpp"
+#include "search_stats.hpp"
+#include "solvability_cache.hpp"
+#include "solver_cost_model.hpp"
+#include "transposition_table.hpp"
 
 #include <algorithm>
 #include <array>
@@ -9,17 +16,54 @@
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <optional>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 constexpr std::size_t kMaxPolyominoSize = 9;
+// Most pieces of a configuration that fits on a board, every piece covers at
+// least one of its at most 64 cells.
+constexpr std::size_t kMaxPieces = 64;
 extern const std::array<std::vector<CandidateMatchBitmask>, kMaxPolyominoSize>
     kPrecomputedPolyminosMatchSet;
 extern const std::array<std::vector<std::vector<std::pair<int8_t, int8_t>>>, kMaxPolyominoSize>
     kPrecomputedPolyominosTypeErased;
 extern const std::array<std::string, 14> kColors;
 
+// Solutions of a configuration, as placed on the board and once more
+// counting the solutions that a rotation or reflection of the board maps
+// onto each other as one.
+struct SolutionCounts {
+  uint64_t raw{};
+  uint64_t up_to_symmetry{};
+};
+
+// A count estimated from random probes of a search tree: the mean of the
+// probes and a confidence interval around it.
+struct SampledCount {
+  double mean{};
+  double low{};
+  double high{};
+};
+
+// Result of PuzzleSolver::SampleDifficulty. The difficulty is that of
+// EstimateDifficulty with the counts replaced by their estimates, low and
+// high combine the bounds of the counts.
+struct DifficultyEstimate {
+  double difficulty{};
+  double low{};
+  double high{};
+  SampledCount solutions;
+  // positions of the piece left out with the fewest of them
+  SampledCount positions;
+  // nodes visited by all probes
+  uint64_t nodes{};
+};
+
 struct SolutionStats {
   uint64_t possibilities_at_last_step{1};
   uint64_t solution_count{0};
@@ -64,6 +108,23 @@ struct PuzzleParams {
         }
       }
     }   
+    const auto sorted_cells = board.sorted().xy_cords;
+    cells.assign(sorted_cells.begin(), sorted_cells.end());
+    neighbours.resize(N);
+    for (std::size_t i = 0; i < N; ++i) {
+      for (std::size_t j = 0; j < N; ++j) {
+        if (std::abs(cells[i].first - cells[j].first) +
+                std::abs(cells[i].second - cells[j].second) ==
+            1) {
+          neighbours[i] |= BitMaskType{1} << j;
+        }
+      }
+    }
+    std::vector<std::vector<std::pair<int8_t, int8_t>>> images;
+    for (const auto &symmetry : board.sorted().symmetries()) {
+      images.push_back(symmetry.xy_cords_vector());
+    }
+    setAutomorphisms(images);
   }
 
   struct Tile {
@@ -74,28 +135,191 @@ struct PuzzleParams {
   uint64_t possibilities_for_partition(const std::vector<int> &partition) const;
   double possibilities_for_configuration(
       const std::vector<PolyominoSubsetIndex> &configuration) const;
+  // what SolverCostModel predicts the solving time from
+  SolverCostModel::Features cost_features(
+      const std::vector<PolyominoSubsetIndex> &configuration) const;
 
   const std::vector<BitMaskType> &
   operator[](PolyominoSubsetIndex idx) const noexcept;
   const std::vector<std::pair<int8_t, int8_t>> &xy_coordinates (PolyominoSubsetIndex idx) const noexcept;
 
+  // False if the empty cells split into regions that pieces with the given
+  // subset sums (bit k set if some of the pieces have k cells in total) and
+  // total area can't fill, leaving at most slack cells uncovered overall.
+  // If it returns true and num_regions is given, it is set to the number of
+  // regions.
+  bool RegionsCanBeFilled(BitMaskType empty, uint64_t subset_sums,
+                          std::size_t area, std::size_t slack,
+                          std::size_t *num_regions = nullptr) const noexcept;
+  // The connected part of empty that contains cell.
+  BitMaskType Region(BitMaskType empty, std::size_t cell) const noexcept;
+  // The cells mapped by automorphisms[automorphism].
+  BitMaskType Permute(BitMaskType cells,
+                      std::size_t automorphism) const noexcept;
+
   std::size_t N;
   std::array<std::vector<Tile>, kPrecomputedPolyminosMatchSet.size()>
       possible_tiles_per_size;
+  // cells[i]: coordinates of cell i, sorted by (y, x)
+  std::vector<std::pair<int8_t, int8_t>> cells;
+  // neighbours[i]: cells sharing an edge with cell i
+  std::vector<BitMaskType> neighbours;
+  // The rotations and reflections that map the board onto itself, as
+  // permutations of the cells, the identity first: automorphisms[g][i] is
+  // the cell that g maps cell i to.
+  std::vector<std::vector<uint8_t>> automorphisms;
+
+private:
+  // images[s][i]: cell i under the s-th of Polyomino::symmetries(), the
+  // first one the identity
+  void setAutomorphisms(
+      const std::vector<std::vector<std::pair<int8_t, int8_t>>> &images);
 };
 
+// Scratch buffers of PuzzleSolver::Solve and EstimateDifficulty. They grow
+// to the largest configuration solved and are reused afterwards, so that
+// solving configuration after configuration doesn't allocate. Like a solver
+// it must not be used from several threads at the same time, but the solvers
+// of different boards can share it, see PuzzleSolver::Options::workspace.
+class SolverWorkspace {
+public:
+  SolverWorkspace();
+  ~SolverWorkspace();
+
+private:
+  friend class PuzzleSolver;
+  struct Buffers;
+  std::unique_ptr<Buffers> buffers;
+};
+
+class MeetInTheMiddleSolver;
+
 class PuzzleSolver {
 public:
-  enum class Algoritm { DLX, BF };
+  // AUTO dispatches to the backend that Options::cost_model predicts to be
+  // the fastest for the configuration. MITM solves with a
+  // MeetInTheMiddleSolver on boards of up to its kMaxCells cells and falls
+  // back to BF on larger ones, AUTO doesn't pick it. SolveAtMost runs BF
+  // for it.
+  enum class Algoritm { DLX, BF, BITSET, AUTO, MITM };
+  // What the BF search branches on
+  enum class Branching {
+    // the placements of the pieces, in the order of the configuration
+    PIECES,
+    // the placements covering the empty cell with the fewest of them, the
+    // copies of a piece are interchangeable
+    CELLS,
+  };
+  struct Options {
+    // column choice of the DLX search
+    DLMatrix::Heuristic dlx_heuristic = DLMatrix::Heuristic::MRV;
+    // backtrack as soon as the empty cells form a region the remaining pieces
+    // can't fill (BF and DLX)
+    bool prune_regions = true;
+    // once the empty cells fall apart into several regions, split the
+    // remaining pieces among them and solve every region on its own, with
+    // the results cached by region shape and pieces (BF). Only pays off on
+    // large boards, on small ones the splits cost more than they save.
+    bool decompose_regions = false;
+    // branching of the BF search, decompose_regions only applies to PIECES
+    Branching bf_branching = Branching::CELLS;
+    // The BF search remembers the states it found to be dead ends, and
+    // EstimateDifficulty the counts below the states it walked, in tables of
+    // 2^transposition_table_bits entries. 0 switches them off.
+    std::size_t transposition_table_bits = 16;
+    // Cache shared between solvers, possibly of other boards and threads,
+    // that keeps the dead ends of the CELLS search and which pieces fit into
+    // the regions of decompose_regions. Must outlive the solver.
+    SolvabilityCache *shared_cache = nullptr;
+    // Cost model of Algoritm::AUTO, SolverCostModel::Default() if not given.
+    // Must outlive the solver.
+    const SolverCostModel *cost_model = nullptr;
+    // On boards with rotations or reflections onto themselves, place one of
+    // the pieces that appear once at only one placement of every class of
+    // placements the symmetries map onto each other (the CELLS search and
+    // EstimateDifficulty). Every other solution is a symmetric image of one
+    // found this way, so Solve finds one if there is one and the counts are
+    // weighted by the sizes of the classes.
+    bool break_symmetries = true;
+    // Scratch buffers, e.g. one per thread for the solvers of all boards it
+    // works on. The solver uses its own if not given. Must outlive the
+    // solver.
+    SolverWorkspace *workspace = nullptr;
+  };
+
+  // A solver caches state between calls and must not be used from several
+  // threads at the same time, use one solver per thread.
   PuzzleSolver(const PuzzleParams &params);
+  PuzzleSolver(const PuzzleParams &params, const Options &options);
+  ~PuzzleSolver();
 
   bool Solve(const std::vector<PolyominoSubsetIndex> &candidate_tiles,
              std::vector<std::size_t> &foundSolution,
-             Algoritm algo = Algoritm::BF) const noexcept;
+             Algoritm algo = Algoritm::BF) noexcept;
+
+  // Collects solutions like the one of Solve until there are max_solutions
+  // of them and stops the search there, e.g. max_solutions = 2 tells
+  // whether the solution is unique. Solutions that only swap copies of a
+  // piece are the same, those that are symmetric images of each other on
+  // the board are not. Runs the DLX search for Algoritm::DLX and the BF
+  // search with Branching::CELLS otherwise. Returns the number of solutions.
+  std::size_t
+  SolveAtMost(const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+              std::size_t max_solutions,
+              std::vector<std::vector<std::size_t>> &solutions,
+              Algoritm algo = Algoritm::BF) noexcept;
+
+  // The solutions of SolveAtMost one at a time, from a search that only
+  // runs up to the next solution whenever the caller asks for it, so the
+  // caller can stop at any point or interleave the searches of several
+  // configurations on one thread. A yielded solution is valid until the
+  // generator resumes. The solver has to outlive the generator.
+  Generator<std::vector<std::size_t>>
+  Solutions(std::vector<PolyominoSubsetIndex> candidate_tiles);
+
+  // The backend Solve runs for Algoritm::AUTO.
+  Algoritm
+  ChooseAlgorithm(const std::vector<PolyominoSubsetIndex> &candidate_tiles)
+      const noexcept;
 
+  // If solutions is given, it gets the number of solutions found on the
+  // way, and up to the symmetries of the board by Burnside's lemma, which
+  // takes another count of the solutions each symmetry maps onto
+  // themselves.
   double
   EstimateDifficulty(const std::vector<PolyominoSubsetIndex> &candidate_tiles,
-                     Algoritm algo = Algoritm::BF) const noexcept;
+                     Algoritm algo = Algoritm::BF,
+                     SolutionCounts *solutions = nullptr) noexcept;
+
+  struct SamplingOptions {
+    // random probes per count
+    std::size_t probes = 256;
+    // Children a probe follows at every node, clamped to kMaxProbeWidth. 1
+    // is Knuth's estimator, a larger width Purdom's partial backtracking,
+    // which has less variance for the same number of nodes on trees with
+    // many dead ends. If no piece has more than the clamped width of
+    // placements, a probe walks the whole tree and its counts are exact.
+    std::size_t width = 1;
+    // of the confidence intervals, 1.96 for about 95%
+    double z = 1.96;
+    uint64_t seed = 0;
+  };
+  static constexpr std::size_t kMaxProbeWidth = 16;
+
+  // Estimates the counts of EstimateDifficulty from random walks down its
+  // search tree in time bounded by the probes, to rank configurations
+  // approximately and count only the most difficult ones exactly. Every
+  // probe gives an unbiased estimate of a count, the confidence intervals
+  // are those of the mean of the probes, which the heavy tails of these
+  // estimates make optimistic for few probes.
+  DifficultyEstimate SampleDifficulty(
+      const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+      const SamplingOptions &sampling) noexcept;
+
+  // statistics of the searches of Solve and EstimateDifficulty, empty unless
+  // built with USE_SEARCH_STATS
+  const SearchStats &stats() const { return search_stats; }
+  void ClearStats() { search_stats.Clear(); }
 
   template <std::size_t N>
   std::string decodeSolution(
@@ -103,18 +327,247 @@ public:
       const std::vector<PolyominoSubsetIndex> &candidate_tiles) const noexcept;
 
 private:
-  bool internalSolve(const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+  // pieces of a brute force search, together with what the region pruning
+  // needs to know about them
+  struct BruteForceProblem;
+  // kDecompose is options.decompose_regions, a template parameter so that
+  // the search without it doesn't test for regions at every node
+  template <bool kDecompose>
+  bool internalSolve(const BruteForceProblem &problem,
                      std::vector<std::size_t> &indices,
                      BitMaskType current_state = 0,
-                     std::size_t current_index = 0) const noexcept;
+                     std::size_t current_index = 0) noexcept;
+  // Like internalSolve for a state whose empty cells fall apart into several
+  // regions, solves the regions one at a time.
+  bool solveRegions(const BruteForceProblem &problem,
+                    std::vector<std::size_t> &indices,
+                    BitMaskType current_state,
+                    std::size_t current_index) noexcept;
+  // Runs search on placement_matrix->matrix with the rows of the pieces,
+  // which cover area <= params.N cells, switched on.
+  template <typename SEARCH>
+  void withPlacementRows(
+      const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+      std::size_t area, SEARCH &&search) noexcept;
+  // the solution of the DLX search with rows
+  void dlxSolution(const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+                   const std::vector<std::size_t> &rows,
+                   std::vector<std::size_t> &solution) const noexcept;
+  // state of a BF search with Branching::CELLS
+  struct CellSearch;
+  // Whether the remaining pieces of the search can fill the empty regions,
+  // true unless options.prune_regions.
+  bool cellRegionsCanBeFilled(const CellSearch &search,
+                              BitMaskType current_state) noexcept;
+  // The empty cell the search branches on, the one with the fewest options
+  // (best_options), placements covering it or leaving it empty.
+  std::size_t branchingCell(const CellSearch &search,
+                            BitMaskType current_state,
+                            std::size_t &best_options) noexcept;
+  bool cellSolve(CellSearch &search, BitMaskType current_state) noexcept;
+  // cellSolve from the empty board with piece t, which appears once, only at
+  // the first placement of every class of placementClasses
+  bool cellSolveSymmetric(CellSearch &search, std::size_t t) noexcept;
+  // the branching of cellSolve, once the state isn't a known dead end
+  bool cellSolveChildren(CellSearch &search,
+                         BitMaskType current_state) noexcept;
+  // placements of the piece covering each cell, indices into params[tile]
+  const std::vector<std::vector<uint32_t>> &
+  placementsByCell(PolyominoSubsetIndex tile) noexcept;
+  // The placements of the piece the automorphisms of the board map onto
+  // each other, as (index into params[tile] of the one with the smallest
+  // mask, size of the class) pairs. Empty if the board has no symmetries.
+  const std::vector<std::pair<uint32_t, uint32_t>> &
+  placementClasses(PolyominoSubsetIndex tile) noexcept;
+  // Solutions that params.automorphisms[automorphism] maps onto themselves.
+  uint64_t countSymmetricSolutions(
+      const std::vector<std::pair<PolyominoSubsetIndex, std::size_t>> &pieces,
+      std::size_t automorphism) noexcept;
+  // Whether the (sorted) pieces fit into region, cached.
+  bool regionCanBePacked(
+      BitMaskType region,
+      const std::vector<PolyominoSubsetIndex> &pieces) noexcept;
+  // keys of region_cache: the canonical shapes of the regions, then the
+  // pieces. The shape is valid until the next call.
+  const std::string &regionShape(BitMaskType region) noexcept;
+  void appendPieces(std::string &key,
+                    const std::vector<PolyominoSubsetIndex> &pieces)
+      const noexcept;
+  void cacheRegionResult(std::string key, bool result) noexcept;
   uint64_t internalCountSolutionsToNminusOne(
       const std::vector<PolyominoSubsetIndex> &candidate_tiles,
       BitMaskType current_state = 0,
       std::size_t current_index = 0) const noexcept;
 
   const PuzzleParams &params;
+  const Options options;
+  // tells the boards apart in the keys of options.shared_cache
+  const uint64_t board_hash;
+  SearchStats search_stats;
+  // results of regionCanBePacked and solveRegions, keyed by the canonical
+  // shapes of the regions and the pieces
+  std::unordered_map<std::string, bool> region_cache;
+  // canonical shapes of the regions seen so far, cleared like region_cache
+  std::unordered_map<BitMaskType, std::string> region_shapes;
+  // Known dead ends of BF searches and the ways to place the remaining
+  // pieces from the states of EstimateDifficulty, allocated on first use.
+  // Every search uses its own generation of the table.
+  std::unique_ptr<TranspositionTable<bool>> dead_states;
+  std::unique_ptr<TranspositionTable<uint64_t>> subtree_counts;
+  // 0 if the tables are switched off
+  uint32_t newDeadStatesGeneration() noexcept;
+  // filled in by placementsByCell and placementClasses
+  std::map<PolyominoSubsetIndex, std::vector<std::vector<uint32_t>>>
+      cell_placements;
+  std::map<PolyominoSubsetIndex, std::vector<std::pair<uint32_t, uint32_t>>>
+      placement_classes;
+
+  // DLX matrix with the placements of every piece on the board, built by the
+  // first DLX solve. Every solve switches on the rows of its pieces and
+  // switches them off again.
+  struct PlacementMatrix;
+  std::unique_ptr<PlacementMatrix> placement_matrix;
+  // built by the first solve with Algoritm::MITM
+  std::unique_ptr<MeetInTheMiddleSolver> meet_in_the_middle;
+
+  // options.workspace or own_workspace
+  SolverWorkspace::Buffers &buffers() noexcept;
+  SolverWorkspace own_workspace;
+};
+
+// Decides the solvability of many configurations that share most of their
+// pieces, the prefix, and differ in the others, the suffix. Prefixes are
+// walked like a trie: the placements of every prefix piece are combined
+// with the states of the pieces before it once, and a new prefix only
+// redoes the pieces after the part it has in common with the previous one.
+// From the states of the whole prefix it keeps which sets of cells the
+// prefix can leave empty, so a suffix is solved by a search over its own
+// pieces only that drops every partial placement the prefix can't complete.
+//
+// The sets are bitsets over all subsets of the cells, the board must not
+// have more than kMaxCells cells.
+class PrefixSolver {
+public:
+  static constexpr std::size_t kMaxCells = 24;
+
+  explicit PrefixSolver(const PuzzleParams &params);
+
+  void SetPrefix(const std::vector<PolyominoSubsetIndex> &prefix);
+  // Whether the pieces of the prefix and suffix can be placed without
+  // overlapping. This is only a packing test: cells may stay empty and
+  // monominos are placed like any other piece. It gives the answer of
+  // PuzzleSolver::Solve for the same pieces because Solve leaves cells empty
+  // too, and more area than params.N fails either way. The copies of a piece
+  // in suffix have to be next to each other.
+  bool Solve(const std::vector<PolyominoSubsetIndex> &suffix);
+
+private:
+  bool solveSuffix(const std::vector<PolyominoSubsetIndex> &suffix,
+                   BitMaskType current_state, std::size_t current_index);
+  bool canStayEmpty(BitMaskType cells) const {
+    return (empty_sets[cells >> 6] >> (cells & 63)) & 1;
+  }
+  void updateEmptySets();
+
+  const PuzzleParams &params;
+  std::vector<PolyominoSubsetIndex> prefix;
+  // states[i]: the cells the first i pieces of prefix can cover, for i up to
+  // prefix.size(). The levels after it are kept for their memory.
+  std::vector<std::vector<BitMaskType>> states;
+  // bit x set if the prefix can be placed so that the cells in x stay empty
+  std::vector<uint64_t> empty_sets;
+  // all zero bitset of the same size for CrossProduct
+  std::vector<uint64_t> seen;
+  // placements of the suffix pieces during solveSuffix
+  std::vector<std::size_t> indices;
 };
 
+// Meet in the middle: splits the pieces of a configuration into two halves,
+// all copies of a piece in the same one, and lists the sets of cells each
+// half can cover, with CrossProduct one piece after the other. A solution
+// joins a set of one half with its complement in the other, the cells left
+// empty go to the first half as monominos. Swaps the depth of the search for
+// two shallower enumerations and the memory of their lists. The lists hold
+// up to 2^N sets of cells, hence the limit on the board. On boards of 24
+// cells filled with dominoes and trominoes it is slower than the BF search
+// both to solve and to count (puzzle_solver_bench), so PuzzleSolver only
+// runs it for Algoritm::MITM.
+class MeetInTheMiddleSolver {
+public:
+  static constexpr std::size_t kMaxCells = 24;
+
+  explicit MeetInTheMiddleSolver(const PuzzleParams &params);
+
+  // Like PuzzleSolver::Solve.
+  bool Solve(const std::vector<PolyominoSubsetIndex> &candidate_tiles,
+             std::vector<std::size_t> &solution);
+  // The number of solutions, with the copies of a piece interchangeable,
+  // like SolutionCounts::raw.
+  uint64_t
+  CountSolutions(const std::vector<PolyominoSubsetIndex> &candidate_tiles);
+
+private:
+  // copies of a piece in a half, the monominos of the empty cells have
+  // first = candidate_tiles.size()
+  struct Group {
+    const std::vector<BitMaskType> *masks;
+    std::size_t copies;
+    // index of a copy in candidate_tiles
+    std::size_t first;
+  };
+  // What is left to place after some copies of a half: the later copies of
+  // the half and all of the other one, the monominos of the empty cells as
+  // holes.
+  struct Rest {
+    uint64_t subset_sums;
+    std::size_t area;
+    std::size_t holes;
+  };
+  // Fills halves and rest, false if the pieces don't fit on the board.
+  bool split(const std::vector<PolyominoSubsetIndex> &candidate_tiles);
+  // Whether the pieces left after level i of half h can still fill the
+  // cells not covered.
+  bool canComplete(std::size_t h, std::size_t i, BitMaskType covered) const {
+    const Rest &r = rest[h][i];
+    return params.RegionsCanBeFilled(~covered & board, r.subset_sums, r.area,
+                                     r.holes);
+  }
+  // Adds the placements of half h that cover exactly cells to placements.
+  void reconstruct(std::size_t h, BitMaskType cells,
+                   std::vector<std::pair<std::size_t, std::size_t>>
+                       &placements) const;
+
+  const PuzzleParams &params;
+  BitMaskType board;
+  // masks of the monominos of the empty cells
+  std::vector<BitMaskType> cells;
+  std::array<std::vector<Group>, 2> halves;
+  // rest[h][i]: left to place after the first i copies of half h
+  std::array<std::vector<Rest>, 2> rest;
+  // levels[h][i]: the cells the first i copies of half h can cover, sorted.
+  // The levels after the last one are kept for their memory.
+  std::array<std::vector<std::vector<BitMaskType>>, 2> levels;
+  // all zero bitset over the sets of cells for CrossProduct
+  std::vector<uint64_t> seen;
+};
+
+// The unions of a mask of a and one of b that don't overlap, sorted and
+// without duplicates.
+std::vector<BitMaskType> CrossProduct(const std::vector<BitMaskType> &a,
+                                      const std::vector<BitMaskType> &b);
+// CrossProduct into result, reusing its memory
+void CrossProduct(const std::vector<BitMaskType> &a,
+                  const std::vector<BitMaskType> &b,
+                  std::vector<BitMaskType> &result);
+// CrossProduct into result for masks of few cells. seen is a bitset over
+// all sets of these cells, all zero before and after, that drops the
+// duplicate unions as they come up instead of collecting and sorting all
+// of them.
+void CrossProduct(const std::vector<BitMaskType> &a,
+                  const std::vector<BitMaskType> &b,
+                  std::vector<uint64_t> &seen,
+                  std::vector<BitMaskType> &result);
+
 void PreProcessConfiguration(std::vector<PolyominoSubsetIndex> &p);
 
 template <std::size_t N>
@@ -0,0 +1,79 @@
+#include "puzzle_solver.hpp"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+// Replaces the global operator new of the binary to count the allocations,
+// hence a test binary of its own.
+namespace {
+std::atomic<uint64_t> allocations{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+// not inlined, GCC can't tell that the pointers come from the malloc above
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+
+TEST(PuzzleSolver, SolveDoesNotAllocate) {
+  // once the workspace and the caches of the solvers have grown, solving and
+  // counting more configurations allocates nothing, also with the workspace
+  // shared between solvers
+  if (kSearchStatsEnabled) {
+    GTEST_SKIP() << "the search statistics grow on the heap";
+  }
+  const auto rectangle = CreateRectangle<4, 5>();
+  PuzzleParams params{rectangle};
+  SolverWorkspace workspace;
+  PuzzleSolver solver(params, {.workspace = &workspace});
+  PuzzleSolver other_solver(params, {.bf_branching =
+                                         PuzzleSolver::Branching::PIECES,
+                                     .workspace = &workspace});
+
+  std::mt19937 gen(44);
+  std::vector<std::vector<PolyominoSubsetIndex>> configurations;
+  while (configurations.size() < 8) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 18) {
+      const std::size_t size = 3 + gen() % 2;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    configurations.push_back(candidate_tiles);
+  }
+  std::vector<std::size_t> solution;
+  std::vector<double> difficulties;
+  difficulties.reserve(configurations.size());
+  const auto solve_all = [&]() {
+    difficulties.clear();
+    for (const auto &candidate_tiles : configurations) {
+      solver.Solve(candidate_tiles, solution, PuzzleSolver::Algoritm::DLX);
+      other_solver.Solve(candidate_tiles, solution);
+      if (solver.Solve(candidate_tiles, solution)) {
+        difficulties.push_back(solver.EstimateDifficulty(candidate_tiles));
+      }
+    }
+  };
+  solve_all();
+  const auto first_difficulties = difficulties;
+  const uint64_t before = allocations.load();
+  solve_all();
+  EXPECT_EQ(allocations.load() - before, 0u);
+  EXPECT_EQ(difficulties, first_difficulties);
+  EXPECT_FALSE(difficulties.empty());
+}
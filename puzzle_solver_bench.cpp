@@ -3,8 +3,15 @@
 
 #include <benchmark/benchmark.h>
 
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string_view>
 
-void BM_SolveUnsatisfiable14(benchmark::State &state, PuzzleSolver::Algoritm algo) {
+
+void BM_SolveUnsatisfiable14(benchmark::State &state, PuzzleSolver::Algoritm algo,
+                             DLMatrix::Heuristic heuristic = DLMatrix::Heuristic::MRV) {
   const auto square = RemoveOne(RemoveOne(CreateSquare<4>(), 3), 1);
   PuzzleParams params{square};
   std::vector<std::size_t> solution;
@@ -12,15 +19,25 @@ void BM_SolveUnsatisfiable14(benchmark::State &state, PuzzleSolver::Algoritm alg
   for (int i = 0; i < square.size / 2; ++i) {
     candidate_tiles.push_back(PolyominoSubsetIndex{2, 0});
   }
-  PuzzleSolver solver(params);
+  PuzzleSolver solver(params, {.dlx_heuristic = heuristic});
   for (auto _ : state) {
     solver.Solve(candidate_tiles, solution, algo);
   }
 }
 BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "BF", PuzzleSolver::Algoritm::BF);
 BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "DLX", PuzzleSolver::Algoritm::DLX);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "BITSET", PuzzleSolver::Algoritm::BITSET);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "AUTO", PuzzleSolver::Algoritm::AUTO);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "MITM", PuzzleSolver::Algoritm::MITM);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "DLX_MRV_BUCKETS", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::MRV_BUCKETS);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "DLX_PREFER_FIRST_COLUMNS", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::PREFER_FIRST_COLUMNS);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable14, "DLX_MRV_RANDOM_TIES", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::MRV_RANDOM_TIES);
 
-void BM_SolveUnsatisfiable16(benchmark::State &state, PuzzleSolver::Algoritm algo) {
+void BM_SolveUnsatisfiable16(benchmark::State &state, PuzzleSolver::Algoritm algo,
+                             DLMatrix::Heuristic heuristic = DLMatrix::Heuristic::MRV) {
   const auto square = RemoveOne(RemoveOne(CreateRectangle<3,6>(),3),1);
   PuzzleParams params{square};
   std::vector<PolyominoSubsetIndex> candidate_tiles;
@@ -28,15 +45,25 @@ void BM_SolveUnsatisfiable16(benchmark::State &state, PuzzleSolver::Algoritm alg
   for (int i = 0; i < square.size / 2; ++i) {
     candidate_tiles.push_back(PolyominoSubsetIndex{2, 0});
   }
-  PuzzleSolver solver(params);
+  PuzzleSolver solver(params, {.dlx_heuristic = heuristic});
   for (auto _ : state) {
     solver.Solve(candidate_tiles, solution, algo);
   }
 }
 BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "BF", PuzzleSolver::Algoritm::BF);
 BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "DLX", PuzzleSolver::Algoritm::DLX);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "BITSET", PuzzleSolver::Algoritm::BITSET);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "AUTO", PuzzleSolver::Algoritm::AUTO);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "MITM", PuzzleSolver::Algoritm::MITM);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "DLX_MRV_BUCKETS", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::MRV_BUCKETS);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "DLX_PREFER_FIRST_COLUMNS", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::PREFER_FIRST_COLUMNS);
+BENCHMARK_CAPTURE(BM_SolveUnsatisfiable16, "DLX_MRV_RANDOM_TIES", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::MRV_RANDOM_TIES);
 
-void BM_LargeSquare(benchmark::State &state, PuzzleSolver::Algoritm algo) {
+void BM_LargeSquare(benchmark::State &state, PuzzleSolver::Algoritm algo,
+                    DLMatrix::Heuristic heuristic = DLMatrix::Heuristic::MRV) {
   const auto square = CreateRectangle<6, 5>();
   PuzzleParams params{square};
   std::vector<PolyominoSubsetIndex> candidate_tiles;
@@ -44,12 +71,178 @@ void BM_LargeSquare(benchmark::State &state, PuzzleSolver::Algoritm algo) {
   for (std::size_t i = 0; i < square.size / 5; ++i) {
     candidate_tiles.push_back(PolyominoSubsetIndex{5, i});
   }
-  PuzzleSolver solver(params);
+  PuzzleSolver solver(params, {.dlx_heuristic = heuristic});
   for (auto _ : state) {
     solver.Solve(candidate_tiles, solution, algo);
   }
 }
 BENCHMARK_CAPTURE(BM_LargeSquare, "BF", PuzzleSolver::Algoritm::BF);
 BENCHMARK_CAPTURE(BM_LargeSquare, "DLX", PuzzleSolver::Algoritm::DLX);
+BENCHMARK_CAPTURE(BM_LargeSquare, "BITSET", PuzzleSolver::Algoritm::BITSET);
+BENCHMARK_CAPTURE(BM_LargeSquare, "AUTO", PuzzleSolver::Algoritm::AUTO);
+BENCHMARK_CAPTURE(BM_LargeSquare, "DLX_MRV_BUCKETS", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::MRV_BUCKETS);
+BENCHMARK_CAPTURE(BM_LargeSquare, "DLX_PREFER_FIRST_COLUMNS", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::PREFER_FIRST_COLUMNS);
+BENCHMARK_CAPTURE(BM_LargeSquare, "DLX_MRV_RANDOM_TIES", PuzzleSolver::Algoritm::DLX,
+                  DLMatrix::Heuristic::MRV_RANDOM_TIES);
 
-BENCHMARK_MAIN();
+// Counts all solutions of 20 solvable configurations of dominoes and
+// trominoes on a 4x6 board, with MeetInTheMiddleSolver::CountSolutions for
+// MITM and by collecting them with SolveAtMost otherwise.
+void BM_CountSolutions24(benchmark::State &state, PuzzleSolver::Algoritm algo) {
+  const auto board = CreateRectangle<4, 6>();
+  PuzzleParams params{board};
+  PuzzleSolver solver(params);
+  MeetInTheMiddleSolver mitm_solver(params);
+  std::mt19937 gen(49);
+  std::vector<std::vector<PolyominoSubsetIndex>> configurations;
+  std::vector<std::size_t> solution;
+  while (configurations.size() < 20) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < board.size) {
+      std::size_t size = 2 + gen() % 2;
+      if (board.size - area - size == 1) {
+        size = 5 - size;
+      }
+      size = std::min<std::size_t>(size, board.size - area);
+      candidate_tiles.push_back(PolyominoSubsetIndex{
+          size, gen() % params.possible_tiles_per_size[size - 1].size()});
+      area += size;
+    }
+    PreProcessConfiguration(candidate_tiles);
+    if (solver.Solve(candidate_tiles, solution)) {
+      configurations.push_back(std::move(candidate_tiles));
+    }
+  }
+  std::vector<std::vector<std::size_t>> solutions;
+  for (auto _ : state) {
+    for (const auto &candidate_tiles : configurations) {
+      if (algo == PuzzleSolver::Algoritm::MITM) {
+        benchmark::DoNotOptimize(mitm_solver.CountSolutions(candidate_tiles));
+      } else {
+        benchmark::DoNotOptimize(solver.SolveAtMost(
+            candidate_tiles, std::numeric_limits<std::size_t>::max(),
+            solutions, algo));
+      }
+    }
+  }
+}
+BENCHMARK_CAPTURE(BM_CountSolutions24, "BF", PuzzleSolver::Algoritm::BF);
+BENCHMARK_CAPTURE(BM_CountSolutions24, "DLX", PuzzleSolver::Algoritm::DLX);
+BENCHMARK_CAPTURE(BM_CountSolutions24, "MITM", PuzzleSolver::Algoritm::MITM);
+
+// Times every backend on random configurations of pieces with
+// min_size..max_size cells that fill the board.
+template <std::size_t N>
+void TimeBackends(const Polyomino<N> &board, std::size_t min_size,
+                  std::size_t max_size, int rounds,
+                  std::vector<SolverCostModel::Sample> &samples) {
+  const PuzzleParams params{board};
+  PuzzleSolver solver(params);
+  std::mt19937 gen(N);
+  std::vector<std::size_t> solution;
+  for (int round = 0; round < rounds; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area + min_size <= N) {
+      std::size_t size = min_size + gen() % (max_size - min_size + 1);
+      if (area + size > N || N - area - size < min_size) {
+        size = std::min(N - area, max_size);
+      }
+      const auto &tiles = params.possible_tiles_per_size[size - 1];
+      if (tiles.empty()) {
+        break;
+      }
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, gen() % tiles.size()});
+      area += size;
+    }
+    if (area != N) {
+      continue;
+    }
+    PreProcessConfiguration(candidate_tiles);
+    const auto features = params.cost_features(candidate_tiles);
+    for (std::size_t backend = 0; backend < SolverCostModel::kNumBackends;
+         ++backend) {
+      const auto algo = static_cast<PuzzleSolver::Algoritm>(backend);
+      // repeat fast solves so that the clock resolution doesn't matter
+      int repetitions = 0;
+      const auto start = std::chrono::steady_clock::now();
+      std::chrono::duration<double> elapsed{};
+      do {
+        solver.Solve(candidate_tiles, solution, algo);
+        ++repetitions;
+        elapsed = std::chrono::steady_clock::now() - start;
+      } while (elapsed.count() < 1e-4);
+      samples.push_back({features, backend, elapsed.count() / repetitions});
+    }
+  }
+}
+
+// Fits the cost model of PuzzleSolver::Algoritm::AUTO to timings on this
+// machine and writes it to path, for puzzle_maker --cost_model=path.
+int Calibrate(const std::string &path) {
+  std::vector<SolverCostModel::Sample> samples;
+  TimeBackends(CreateSquare<4>(), 2, 4, 500, samples);
+  TimeBackends(CreateRectangle<3, 6>(), 2, 5, 300, samples);
+  TimeBackends(RemoveOne(CreateSquare<5>(), 0), 3, 5, 300, samples);
+  TimeBackends(CreateSquare<5>(), 3, 6, 300, samples);
+  TimeBackends(CreateRectangle<4, 8>(), 3, 5, 200, samples);
+  // Fit to every other configuration and report the totals of the backends
+  // on the others, which the fit didn't see. The model written out is
+  // fitted to all of them.
+  std::vector<SolverCostModel::Sample> training;
+  std::vector<SolverCostModel::Sample> held_out;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    (i / SolverCostModel::kNumBackends % 2 == 0 ? training : held_out)
+        .push_back(samples[i]);
+  }
+  const auto training_model = SolverCostModel::Fit(training);
+  const auto default_model = SolverCostModel::Default();
+
+  std::size_t configurations = held_out.size() / SolverCostModel::kNumBackends;
+  std::array<double, SolverCostModel::kNumBackends + 3> totals{};
+  for (std::size_t i = 0; i < held_out.size();
+       i += SolverCostModel::kNumBackends) {
+    double best = held_out[i].seconds;
+    for (std::size_t b = 0; b < SolverCostModel::kNumBackends; ++b) {
+      totals[b] += held_out[i + b].seconds;
+      best = std::min(best, held_out[i + b].seconds);
+    }
+    totals[SolverCostModel::kNumBackends] +=
+        held_out[i + training_model.Cheapest(held_out[i].features)].seconds;
+    totals[SolverCostModel::kNumBackends + 1] +=
+        held_out[i + default_model.Cheapest(held_out[i].features)].seconds;
+    totals[SolverCostModel::kNumBackends + 2] += best;
+  }
+  std::cout << configurations
+            << " held out configurations, total seconds DLX " << totals[0]
+            << " BF " << totals[1] << " BITSET " << totals[2] << " AUTO "
+            << totals[3] << " (default model " << totals[4]
+            << ", best possible " << totals[5] << ")\n";
+
+  const auto model = SolverCostModel::Fit(samples);
+  std::ofstream out(path);
+  model.Save(out);
+  if (!out) {
+    std::cerr << "Can't write " << path << "\n";
+    return 1;
+  }
+  model.Save(std::cout);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  constexpr std::string_view kCalibrate = "--calibrate=";
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg.starts_with(kCalibrate)) {
+      return Calibrate(std::string(arg.substr(kCalibrate.size())));
+    }
+  }
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -4,16 +4,21 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <algorithm>
 #include <iostream>
 #include <numeric>
 #include <random>
+#include <set>
 
 class PuzzleSolverTest
     : public ::testing::TestWithParam<PuzzleSolver::Algoritm> {};
 
 INSTANTIATE_TEST_SUITE_P(SolverTest, PuzzleSolverTest,
                          ::testing::Values(PuzzleSolver::Algoritm::BF,
-                                           PuzzleSolver::Algoritm::DLX));
+                                           PuzzleSolver::Algoritm::DLX,
+                                           PuzzleSolver::Algoritm::BITSET,
+                                           PuzzleSolver::Algoritm::AUTO,
+                                           PuzzleSolver::Algoritm::MITM));
 
 TEST_P(PuzzleSolverTest, SimpleSolve) {
   const auto square = CreateSquare<4>();
@@ -57,6 +62,140 @@ TEST_P(PuzzleSolverTest, LargeSquare) {
   std::cout << solver.decodeSolution(square, solution, candidate_tiles) << std::endl;
 }
 
+TEST_P(PuzzleSolverTest, ReusedSolver) {
+  // one solver for many configurations gives the same answers as BF without
+  // pruning
+  const auto square = CreateSquare<4>();
+  PuzzleParams params{square};
+  PuzzleSolver solver(params);
+  PuzzleSolver reference(
+      params, {.prune_regions = false,
+               .bf_branching = PuzzleSolver::Branching::PIECES});
+
+  std::mt19937 gen(42);
+  for (int round = 0; round < 200; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 12) {
+      const std::size_t size = 2 + gen() % 3;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    std::vector<std::size_t> reference_solution;
+    const bool solved = solver.Solve(candidate_tiles, solution, GetParam());
+    ASSERT_EQ(solved, reference.Solve(candidate_tiles, reference_solution,
+                                      PuzzleSolver::Algoritm::BF));
+    if (!solved) {
+      continue;
+    }
+    ASSERT_EQ(solution.size(), candidate_tiles.size());
+    BitMaskType covered = 0;
+    for (std::size_t i = 0; i < candidate_tiles.size(); ++i) {
+      const auto mask = params[candidate_tiles[i]][solution[i]];
+      EXPECT_EQ(covered & mask, 0u);
+      covered |= mask;
+    }
+  }
+}
+
+// BF variants that find a solution exactly when the search over the pieces in
+// order does
+class BruteForceOptionsTest
+    : public ::testing::TestWithParam<PuzzleSolver::Options> {};
+
+INSTANTIATE_TEST_SUITE_P(
+    BruteForce, BruteForceOptionsTest,
+    ::testing::Values(
+        PuzzleSolver::Options{.decompose_regions = true,
+                              .bf_branching = PuzzleSolver::Branching::PIECES},
+        PuzzleSolver::Options{.bf_branching = PuzzleSolver::Branching::CELLS},
+        PuzzleSolver::Options{.prune_regions = false,
+                              .bf_branching = PuzzleSolver::Branching::CELLS}));
+
+TEST_P(BruteForceOptionsTest, SameAsPieceOrder) {
+  // also with the caches of the solver warmed up by earlier puzzles
+  const auto square = CreateSquare<5>();
+  PuzzleParams params{square};
+  PuzzleSolver solver(params, GetParam());
+  PuzzleSolver reference(params,
+                         {.bf_branching = PuzzleSolver::Branching::PIECES});
+
+  std::mt19937 gen(7);
+  for (int round = 0; round < 100; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 22) {
+      const std::size_t size = 2 + gen() % 4;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    if (area > 25) {
+      continue;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    std::vector<std::size_t> reference_solution;
+    const bool solved = solver.Solve(candidate_tiles, solution);
+    ASSERT_EQ(solved, reference.Solve(candidate_tiles, reference_solution));
+    if (!solved) {
+      continue;
+    }
+    BitMaskType covered = 0;
+    for (std::size_t i = 0; i < candidate_tiles.size(); ++i) {
+      const auto mask = params[candidate_tiles[i]][solution[i]];
+      EXPECT_EQ(covered & mask, 0u);
+      covered |= mask;
+    }
+  }
+}
+
+TEST(PuzzleParams, RegionsCanBeFilled) {
+  // cell 4 * y + x of the 4x4 square is at (x, y)
+  const auto square = CreateSquare<4>();
+  PuzzleParams params{square};
+  EXPECT_EQ(params.neighbours[0], BitMaskType{0b1'0010});
+  EXPECT_EQ(params.neighbours[5], BitMaskType{0b10'0101'0010});
+
+  // a wall at x = 2 splits the empty cells into an 8 and a 3 cell region
+  const BitMaskType wall = 0b0100'0100'0100'0100;
+  const BitMaskType empty = 0xFFFF & ~wall & ~BitMaskType{0b1000};
+  const auto sums = [](std::vector<std::size_t> sizes) {
+    uint64_t result = 1;
+    for (const auto size : sizes) {
+      result |= result << size;
+    }
+    return result;
+  };
+  EXPECT_TRUE(params.RegionsCanBeFilled(empty, sums({4, 4, 3}), 11, 0));
+  EXPECT_FALSE(params.RegionsCanBeFilled(empty, sums({5, 6}), 11, 0));
+  EXPECT_FALSE(params.RegionsCanBeFilled(empty, sums({4, 4, 2}), 10, 0));
+  EXPECT_TRUE(params.RegionsCanBeFilled(empty, sums({4, 4, 2}), 10, 1));
+}
+
+TEST(PuzzleParams, Automorphisms) {
+  const auto square = CreateSquare<4>();
+  const auto rectangle = CreateRectangle<4, 5>();
+  // without the corner only the diagonal is left
+  const auto corner = RemoveOne(CreateSquare<4>(), 0);
+  EXPECT_EQ(PuzzleParams{square}.automorphisms.size(), 8u);
+  EXPECT_EQ(PuzzleParams{rectangle}.automorphisms.size(), 4u);
+  PuzzleParams params{corner};
+  ASSERT_EQ(params.automorphisms.size(), 2u);
+  const BitMaskType board = (BitMaskType{1} << params.N) - 1;
+  const BitMaskType first = 1;
+  for (std::size_t g = 0; g < params.automorphisms.size(); ++g) {
+    EXPECT_EQ(params.Permute(board, g), board);
+    EXPECT_EQ(params.Permute(params.Permute(first, g), g), first);
+  }
+  EXPECT_NE(params.Permute(first, 1), first);
+}
+
 TEST(PuzzleSolver, TestDifficulty) {
   const auto square = CreateRectangle<6, 5>();
   PuzzleParams params{square};
@@ -68,4 +207,604 @@ TEST(PuzzleSolver, TestDifficulty) {
     candidate_tiles.push_back(PolyominoSubsetIndex{5, i});
   }
   std::cout << solver.EstimateDifficulty(candidate_tiles) << std::endl;
-}
\ No newline at end of file
+}
+
+TEST(PuzzleSolver, DifficultyLeavesOutEveryPiece) {
+  // log2 of the fewest ways to place all pieces but one, less the log of
+  // the number of solutions, with the copies of a piece interchangeable
+  const auto square = CreateSquare<4>();
+  PuzzleParams params{square};
+  PuzzleSolver solver(params);
+
+  const auto arrangements =
+      [&](const std::vector<PolyominoSubsetIndex> &pieces) -> uint64_t {
+    // ways to place the pieces with the copies told apart
+    const auto count = [&](auto &&self, BitMaskType state,
+                           std::size_t i) -> uint64_t {
+      if (i == pieces.size()) {
+        return 1;
+      }
+      uint64_t result = 0;
+      for (const auto mask : params[pieces[i]]) {
+        if ((state & mask) == 0) {
+          result += self(self, state | mask, i + 1);
+        }
+      }
+      return result;
+    };
+    uint64_t result = count(count, 0, 0);
+    for (auto it = pieces.begin(); it != pieces.end();) {
+      const auto end = std::upper_bound(it, pieces.end(), *it);
+      for (uint64_t k = 2; k <= static_cast<uint64_t>(end - it); ++k) {
+        result /= k;
+      }
+      it = end;
+    }
+    return result;
+  };
+
+  std::mt19937 gen(7);
+  int checked = 0;
+  for (int round = 0; round < 100; ++round) {
+    // few different pieces, so that most configurations repeat some
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 11) {
+      const std::size_t size = 2 + gen() % 2;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    const uint64_t solutions = arrangements(candidate_tiles);
+    if (solutions == 0) {
+      continue;
+    }
+    uint64_t fewest = std::numeric_limits<uint64_t>::max();
+    for (std::size_t i = 0; i < candidate_tiles.size(); ++i) {
+      auto rest = candidate_tiles;
+      rest.erase(rest.begin() + i);
+      fewest = std::min(fewest, arrangements(rest));
+    }
+    EXPECT_DOUBLE_EQ(solver.EstimateDifficulty(candidate_tiles),
+                     std::log2(fewest) - std::log(solutions));
+    ++checked;
+  }
+  EXPECT_GT(checked, 10);
+}
+
+TEST(PuzzleSolver, BreakSymmetries) {
+  // placing the first piece at one placement of every symmetric class
+  // changes neither the answers of Solve nor the counts of the difficulty
+  const auto rectangle = CreateRectangle<4, 5>();
+  PuzzleParams params{rectangle};
+  PuzzleSolver solver(params);
+  PuzzleSolver reference(params, {.break_symmetries = false});
+
+  std::mt19937 gen(46);
+  int solved = 0;
+  for (int round = 0; round < 40; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 17) {
+      const std::size_t size = 3 + gen() % 3;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    const bool solvable = reference.Solve(candidate_tiles, solution);
+    ASSERT_EQ(solver.Solve(candidate_tiles, solution), solvable);
+    if (!solvable) {
+      continue;
+    }
+    ++solved;
+    EXPECT_DOUBLE_EQ(solver.EstimateDifficulty(candidate_tiles),
+                     reference.EstimateDifficulty(candidate_tiles));
+  }
+  EXPECT_GT(solved, 5);
+}
+
+TEST(PuzzleSolver, SolutionsUpToSymmetry) {
+  // every solution as the sorted placements of its pieces, the classes
+  // under the symmetries of the board told apart by their smallest image
+  const auto rectangle = CreateRectangle<3, 4>();
+  PuzzleParams params{rectangle};
+  PuzzleSolver solver(params);
+
+  std::mt19937 gen(12);
+  int checked = 0;
+  for (int round = 0; round < 30; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 9) {
+      const std::size_t size = 2 + gen() % 2;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    using Solution = std::vector<std::pair<PolyominoSubsetIndex, BitMaskType>>;
+    std::set<Solution> solutions;
+    Solution placed;
+    const auto place = [&](auto &&self, BitMaskType state,
+                           std::size_t i) -> void {
+      if (i == candidate_tiles.size()) {
+        auto sorted = placed;
+        std::sort(sorted.begin(), sorted.end());
+        solutions.insert(sorted);
+        return;
+      }
+      for (const auto mask : params[candidate_tiles[i]]) {
+        if ((state & mask) == 0) {
+          placed.emplace_back(candidate_tiles[i], mask);
+          self(self, state | mask, i + 1);
+          placed.pop_back();
+        }
+      }
+    };
+    place(place, 0, 0);
+    if (solutions.empty()) {
+      continue;
+    }
+    std::set<Solution> classes;
+    for (const auto &s : solutions) {
+      Solution smallest = s;
+      for (std::size_t g = 1; g < params.automorphisms.size(); ++g) {
+        Solution image;
+        for (const auto &[tile, mask] : s) {
+          image.emplace_back(tile, params.Permute(mask, g));
+        }
+        std::sort(image.begin(), image.end());
+        smallest = std::min(smallest, image);
+      }
+      classes.insert(smallest);
+    }
+    SolutionCounts counts;
+    solver.EstimateDifficulty(candidate_tiles, PuzzleSolver::Algoritm::BF,
+                              &counts);
+    EXPECT_EQ(counts.raw, solutions.size());
+    EXPECT_EQ(counts.up_to_symmetry, classes.size());
+    ++checked;
+  }
+  EXPECT_GT(checked, 10);
+}
+
+TEST(PuzzleSolver, SolveAtMost) {
+  // the solutions are distinct and valid, as many as there are up to the
+  // limit, also with monominos among the pieces and cells left empty
+  const auto board = RemoveOne(CreateSquare<4>(), 5);
+  PuzzleParams params{board};
+  PuzzleSolver solver(params);
+
+  std::mt19937 gen(47);
+  int several = 0;
+  for (int round = 0; round < 60; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 14) {
+      const std::size_t size = 1 + gen() % 4;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::vector<std::size_t>> all;
+    std::vector<std::size_t> solution(candidate_tiles.size());
+    const auto place = [&](auto &&self, BitMaskType state,
+                           std::size_t i) -> void {
+      if (i == candidate_tiles.size()) {
+        all.push_back(solution);
+        return;
+      }
+      const auto &masks = params[candidate_tiles[i]];
+      // copies in increasing order of their placements
+      const std::size_t start =
+          i > 0 && candidate_tiles[i - 1] == candidate_tiles[i]
+              ? solution[i - 1] + 1
+              : 0;
+      for (std::size_t m = start; m < masks.size(); ++m) {
+        if ((state & masks[m]) == 0) {
+          solution[i] = m;
+          self(self, state | masks[m], i + 1);
+        }
+      }
+    };
+    place(place, 0, 0);
+    std::sort(all.begin(), all.end());
+    several += all.size() > 2;
+    for (const auto algo : {PuzzleSolver::Algoritm::BF,
+                            PuzzleSolver::Algoritm::DLX,
+                            PuzzleSolver::Algoritm::AUTO}) {
+      for (const std::size_t k : {std::size_t{1}, std::size_t{2},
+                                  all.size() + 1}) {
+        std::vector<std::vector<std::size_t>> solutions;
+        ASSERT_EQ(solver.SolveAtMost(candidate_tiles, k, solutions, algo),
+                  std::min(k, all.size()));
+        ASSERT_EQ(solutions.size(), std::min(k, all.size()));
+        std::sort(solutions.begin(), solutions.end());
+        EXPECT_EQ(std::adjacent_find(solutions.begin(), solutions.end()),
+                  solutions.end());
+        for (const auto &found : solutions) {
+          EXPECT_TRUE(std::binary_search(all.begin(), all.end(), found));
+        }
+      }
+    }
+  }
+  EXPECT_GT(several, 10);
+}
+
+TEST(PuzzleSolver, SampleDifficultyWholeTree) {
+  // no piece has more than kMaxProbeWidth placements on the 3x3 square, so
+  // a probe of the full width walks the whole tree
+  const auto square = CreateSquare<3>();
+  PuzzleParams params{square};
+  PuzzleSolver solver(params);
+
+  std::mt19937 gen(48);
+  int checked = 0;
+  for (int round = 0; round < 40; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 7) {
+      const std::size_t size = 2 + gen() % 2;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    if (area > params.N || !solver.Solve(candidate_tiles, solution)) {
+      continue;
+    }
+    for (const auto &tile : candidate_tiles) {
+      ASSERT_LE(params[tile].size(), PuzzleSolver::kMaxProbeWidth);
+    }
+    SolutionCounts counts;
+    const double difficulty = solver.EstimateDifficulty(
+        candidate_tiles, PuzzleSolver::Algoritm::BF, &counts);
+    const auto estimate = solver.SampleDifficulty(
+        candidate_tiles,
+        {.probes = 1, .width = PuzzleSolver::kMaxProbeWidth});
+    EXPECT_DOUBLE_EQ(estimate.solutions.mean, counts.raw);
+    EXPECT_NEAR(estimate.difficulty, difficulty, 1e-9);
+    EXPECT_DOUBLE_EQ(estimate.low, estimate.high);
+    ++checked;
+  }
+  EXPECT_GT(checked, 5);
+}
+
+TEST(PuzzleSolver, SampleDifficultyIntervals) {
+  // the confidence intervals of the probes mostly contain the exact counts
+  const auto rectangle = CreateRectangle<4, 5>();
+  PuzzleParams params{rectangle};
+  PuzzleSolver solver(params);
+
+  std::mt19937 gen(49);
+  int checked = 0;
+  int covered = 0;
+  while (checked < 10) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 17) {
+      const std::size_t size = 3 + gen() % 3;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    if (area > params.N || !solver.Solve(candidate_tiles, solution)) {
+      continue;
+    }
+    SolutionCounts counts;
+    solver.EstimateDifficulty(candidate_tiles, PuzzleSolver::Algoritm::BF,
+                              &counts);
+    for (const std::size_t width : {1, 4}) {
+      const auto estimate = solver.SampleDifficulty(
+          candidate_tiles,
+          {.probes = 2000, .width = width, .seed = uint64_t(checked)});
+      EXPECT_LE(estimate.low, estimate.difficulty);
+      EXPECT_LE(estimate.difficulty, estimate.high);
+      covered += estimate.solutions.low <= counts.raw &&
+                 counts.raw <= estimate.solutions.high;
+    }
+    ++checked;
+  }
+  EXPECT_GE(covered, 15);
+}
+
+TEST(PuzzleSolver, TranspositionTables) {
+  // remembering dead ends and counts changes nothing but the time it takes,
+  // also with one solver reused for many configurations
+  const auto square = CreateRectangle<4, 5>();
+  PuzzleParams params{square};
+  PuzzleSolver solver(params, {.transposition_table_bits = 4});
+  PuzzleSolver pieces_solver(
+      params, {.bf_branching = PuzzleSolver::Branching::PIECES,
+               .transposition_table_bits = 4});
+  PuzzleSolver reference(params, {.transposition_table_bits = 0});
+
+  std::mt19937 gen(3);
+  for (int round = 0; round < 20; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 18) {
+      const std::size_t size = 2 + gen() % 3;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    const bool solved = reference.Solve(candidate_tiles, solution);
+    EXPECT_EQ(solver.Solve(candidate_tiles, solution), solved);
+    EXPECT_EQ(pieces_solver.Solve(candidate_tiles, solution), solved);
+    EXPECT_EQ(solver.EstimateDifficulty(candidate_tiles),
+              reference.EstimateDifficulty(candidate_tiles));
+  }
+}
+
+#ifdef USE_SEARCH_STATS
+TEST(PuzzleSolver, DifficultyCountsShareSubtrees) {
+  // the counts leaving out pieces of the same size share the ways to place
+  // the pieces after them, the table saves the nodes below these states
+  const auto board = CreateRectangle<4, 5>();
+  PuzzleParams params{board};
+  PuzzleSolver solver(params);
+  PuzzleSolver reference(params, {.transposition_table_bits = 0});
+  // four different trominoes and a domino
+  std::vector<PolyominoSubsetIndex> candidate_tiles;
+  for (std::size_t i = 0; i < 4; ++i) {
+    candidate_tiles.push_back(
+        {3, i % params.possible_tiles_per_size[2].size()});
+  }
+  candidate_tiles.push_back({2, 0});
+  std::sort(candidate_tiles.begin(), candidate_tiles.end());
+
+  EXPECT_EQ(solver.EstimateDifficulty(candidate_tiles),
+            reference.EstimateDifficulty(candidate_tiles));
+  const auto nodes = [](const PuzzleSolver &s) {
+    const auto &per_depth = s.stats().nodes_per_depth();
+    return std::accumulate(per_depth.begin(), per_depth.end(), uint64_t{0});
+  };
+  EXPECT_LT(nodes(solver), nodes(reference));
+}
+#endif
+
+TEST(PuzzleSolver, SharedCache) {
+  // solvers of different boards and branchings share one cache without
+  // changing their answers
+  SolvabilityCache cache(12, 2);
+  const auto board = CreateSquare<5>();
+  const auto other_board = RemoveOne(CreateSquare<5>(), 0);
+  PuzzleParams params{board};
+  PuzzleParams other_params{other_board};
+  PuzzleSolver cells_solver(params, {.shared_cache = &cache});
+  PuzzleSolver regions_solver(
+      params, {.decompose_regions = true,
+               .bf_branching = PuzzleSolver::Branching::PIECES,
+               .shared_cache = &cache});
+  PuzzleSolver other_solver(other_params, {.shared_cache = &cache});
+  PuzzleSolver reference(params, {.transposition_table_bits = 0});
+  PuzzleSolver other_reference(other_params, {.transposition_table_bits = 0});
+
+  std::mt19937 gen(5);
+  for (int round = 0; round < 1000; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 22) {
+      const std::size_t size = 3 + gen() % 3;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> solution;
+    const bool solved = reference.Solve(candidate_tiles, solution);
+    EXPECT_EQ(cells_solver.Solve(candidate_tiles, solution), solved);
+    EXPECT_EQ(regions_solver.Solve(candidate_tiles, solution), solved);
+    // the piece indices of the other board are different
+    std::vector<PolyominoSubsetIndex> other_tiles;
+    for (const auto &tile : candidate_tiles) {
+      if (tile.index < other_params.possible_tiles_per_size[tile.N - 1].size()) {
+        other_tiles.push_back(tile);
+      }
+    }
+    EXPECT_EQ(other_solver.Solve(other_tiles, solution),
+              other_reference.Solve(other_tiles, solution));
+  }
+  EXPECT_GT(cache.stats().hits, 0u);
+}
+
+TEST(PrefixSolver, SameAsSolve) {
+  // prefixes change in their last pieces first, like the configurations of
+  // puzzle_maker
+  const auto board = RemoveOne(CreateSquare<4>(), 5);
+  PuzzleParams params{board};
+  PuzzleSolver solver(params);
+  PrefixSolver prefix_solver(params);
+
+  std::mt19937 gen(11);
+  int solvable = 0;
+  std::vector<PolyominoSubsetIndex> prefix;
+  for (int round = 0; round < 300; ++round) {
+    if (round % 20 == 0) {
+      prefix.clear();
+    }
+    while (prefix.size() > 2 || (!prefix.empty() && gen() % 2 == 0)) {
+      prefix.pop_back();
+    }
+    while (prefix.size() < 3) {
+      const std::size_t size = 2 + gen() % 2;
+      prefix.push_back(PolyominoSubsetIndex{
+          size, gen() % params.possible_tiles_per_size[size - 1].size()});
+    }
+    std::vector<PolyominoSubsetIndex> suffix;
+    for (std::size_t area = 0; area < 5;) {
+      const std::size_t size = 2 + gen() % 3;
+      suffix.push_back(PolyominoSubsetIndex{
+          size, gen() % params.possible_tiles_per_size[size - 1].size()});
+      area += size;
+    }
+    std::sort(suffix.begin(), suffix.end());
+    prefix_solver.SetPrefix(prefix);
+
+    auto candidate_tiles = suffix;
+    candidate_tiles.insert(candidate_tiles.end(), prefix.begin(), prefix.end());
+    std::vector<std::size_t> solution;
+    const bool solved = solver.Solve(candidate_tiles, solution);
+    EXPECT_EQ(prefix_solver.Solve(suffix), solved);
+    solvable += solved;
+  }
+  EXPECT_GT(solvable, 20);
+  EXPECT_LT(solvable, 280);
+}
+
+TEST(CrossProduct, DisjointUnions) {
+  // the second and third masks of a overlap, x | y of different pairs can
+  // coincide
+  const std::vector<BitMaskType> a = {0b0001, 0b0110, 0b0010};
+  const std::vector<BitMaskType> b = {0b0100, 0b1000};
+  EXPECT_THAT(CrossProduct(a, b),
+              testing::ElementsAre(0b0101, 0b0110, 0b1001, 0b1010, 0b1110));
+  std::vector<uint64_t> seen(1);
+  std::vector<BitMaskType> result;
+  CrossProduct(a, b, seen, result);
+  EXPECT_THAT(result,
+              testing::ElementsAre(0b0101, 0b0110, 0b1001, 0b1010, 0b1110));
+  EXPECT_THAT(seen, testing::ElementsAre(0));
+}
+
+TEST(MeetInTheMiddleSolver, SameAsSolve) {
+  // solvability, a valid solution and the number of solutions, with and
+  // without empty cells and with repeated pieces
+  const auto rectangle = CreateRectangle<4, 5>();
+  PuzzleParams params{rectangle};
+  PuzzleSolver solver(params);
+  MeetInTheMiddleSolver mitm_solver(params);
+
+  std::mt19937 gen(49);
+  int solvable = 0;
+  for (int round = 0; round < 100; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    const std::size_t min_area = round % 2 == 0 ? 20 : 17;
+    while (area < min_area) {
+      const std::size_t size = 2 + gen() % 3;
+      const std::size_t index =
+          gen() % std::min<std::size_t>(
+                      3, params.possible_tiles_per_size[size - 1].size());
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::sort(candidate_tiles.begin(), candidate_tiles.end());
+    std::vector<std::size_t> expected;
+    const bool solved = solver.Solve(candidate_tiles, expected);
+    std::vector<std::size_t> solution;
+    ASSERT_EQ(mitm_solver.Solve(candidate_tiles, solution), solved);
+    if (!solved) {
+      EXPECT_EQ(mitm_solver.CountSolutions(candidate_tiles), 0u);
+      continue;
+    }
+    ++solvable;
+    ASSERT_EQ(solution.size(), candidate_tiles.size());
+    BitMaskType covered = 0;
+    for (std::size_t i = 0; i < candidate_tiles.size(); ++i) {
+      const BitMaskType mask = params[candidate_tiles[i]][solution[i]];
+      EXPECT_EQ(covered & mask, 0u);
+      covered |= mask;
+    }
+    SolutionCounts counts;
+    solver.EstimateDifficulty(candidate_tiles, PuzzleSolver::Algoritm::BF,
+                              &counts);
+    EXPECT_EQ(mitm_solver.CountSolutions(candidate_tiles), counts.raw);
+  }
+  EXPECT_GT(solvable, 10);
+}
+
+TEST(PuzzleSolver, Solutions) {
+  // the generator yields the solutions of SolveAtMost, and stops where the
+  // caller does
+  const auto board = RemoveOne(CreateSquare<4>(), 5);
+  PuzzleParams params{board};
+  PuzzleSolver solver(params);
+
+  std::mt19937 gen(50);
+  for (int round = 0; round < 30; ++round) {
+    std::vector<PolyominoSubsetIndex> candidate_tiles;
+    std::size_t area = 0;
+    while (area < 13) {
+      const std::size_t size = 1 + gen() % 4;
+      const std::size_t index =
+          gen() % params.possible_tiles_per_size[size - 1].size();
+      candidate_tiles.push_back(PolyominoSubsetIndex{size, index});
+      area += size;
+    }
+    std::vector<std::vector<std::size_t>> expected;
+    solver.SolveAtMost(candidate_tiles, std::numeric_limits<std::size_t>::max(),
+                       expected);
+    std::vector<std::vector<std::size_t>> solutions;
+    for (const auto &solution : solver.Solutions(candidate_tiles)) {
+      solutions.push_back(solution);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(solutions.begin(), solutions.end());
+    EXPECT_EQ(solutions, expected);
+
+    std::size_t taken = 0;
+    for (const auto &solution : solver.Solutions(candidate_tiles)) {
+      EXPECT_EQ(solution.size(), candidate_tiles.size());
+      if (++taken == 2) {
+        break;
+      }
+    }
+    EXPECT_EQ(taken, std::min<std::size_t>(2, expected.size()));
+  }
+}
+
+TEST(PuzzleSolver, InterleavedSolutions) {
+  // the searches of two configurations take turns on one solver
+  const auto board = CreateRectangle<3, 4>();
+  PuzzleParams params{board};
+  PuzzleSolver solver(params);
+  const std::vector<PolyominoSubsetIndex> dominoes(6, {2, 0});
+  const std::vector<PolyominoSubsetIndex> trominoes(4, {3, 0});
+  std::vector<std::vector<std::size_t>> domino_solutions;
+  std::vector<std::vector<std::size_t>> tromino_solutions;
+  solver.SolveAtMost(dominoes, 1000, domino_solutions);
+  solver.SolveAtMost(trominoes, 1000, tromino_solutions);
+  ASSERT_FALSE(domino_solutions.empty());
+
+  auto a = solver.Solutions(dominoes);
+  auto b = solver.Solutions(trominoes);
+  std::size_t num_a = 0;
+  std::size_t num_b = 0;
+  for (auto it_a = a.begin(), it_b = b.begin();
+       it_a != a.end() || it_b != b.end();) {
+    if (it_a != a.end()) {
+      EXPECT_TRUE(std::find(domino_solutions.begin(), domino_solutions.end(),
+                            *it_a) != domino_solutions.end());
+      ++num_a;
+      ++it_a;
+    }
+    if (it_b != b.end()) {
+      EXPECT_TRUE(std::find(tromino_solutions.begin(),
+                            tromino_solutions.end(),
+                            *it_b) != tromino_solutions.end());
+      ++num_b;
+      ++it_b;
+    }
+  }
+  EXPECT_EQ(num_a, domino_solutions.size());
+  EXPECT_EQ(num_b, tromino_solutions.size());
+}
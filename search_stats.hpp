@@ -0,0 +1,144 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Build with -DUSE_SEARCH_STATS to record statistics of the backtracking
+// searches, without it SearchStats is empty and all its methods do nothing.
+#ifdef USE_SEARCH_STATS
+inline constexpr bool kSearchStatsEnabled = true;
+#else
+inline constexpr bool kSearchStatsEnabled = false;
+#endif
+
+// Statistics of a search tree: nodes, children, time spent below the nodes
+// per depth, and dead ends per column (or piece) that could not be covered.
+// The depth is tracked by the NodeScope guards of the recursion.
+template <bool kEnabled> class BasicSearchStats;
+
+template <> class BasicSearchStats<false> {
+public:
+  struct NodeScope {
+    explicit NodeScope(BasicSearchStats &) {}
+  };
+  void AddChildren(uint64_t) {}
+  void DeadEnd(std::size_t) {}
+  void Merge(const BasicSearchStats &) {}
+  void Clear() {}
+  std::string ToJson() const { return "{}"; }
+};
+
+template <> class BasicSearchStats<true> {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Counts a node at the current depth, the nodes created while it is alive
+  // are one level deeper.
+  class NodeScope {
+  public:
+    explicit NodeScope(BasicSearchStats &stats)
+        : stats(stats), depth(stats.depth++), start(Clock::now()) {
+      if (stats.nodes.size() <= depth) {
+        stats.nodes.resize(depth + 1);
+        stats.children.resize(depth + 1);
+        stats.time_ns.resize(depth + 1);
+      }
+      ++stats.nodes[depth];
+    }
+    ~NodeScope() {
+      stats.time_ns[depth] +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               start)
+              .count();
+      --stats.depth;
+    }
+    NodeScope(const NodeScope &) = delete;
+    NodeScope &operator=(const NodeScope &) = delete;
+
+  private:
+    BasicSearchStats &stats;
+    const std::size_t depth;
+    const Clock::time_point start;
+  };
+
+  // children of the current node
+  void AddChildren(uint64_t num_children) {
+    children[depth - 1] += num_children;
+  }
+  // the current node has no children because column can't be covered
+  void DeadEnd(std::size_t column) {
+    if (dead_ends.size() <= column) {
+      dead_ends.resize(column + 1);
+    }
+    ++dead_ends[column];
+  }
+
+  void Merge(const BasicSearchStats &other) {
+    AddTo(nodes, other.nodes);
+    AddTo(children, other.children);
+    AddTo(time_ns, other.time_ns);
+    AddTo(dead_ends, other.dead_ends);
+  }
+  void Clear() { *this = BasicSearchStats{}; }
+
+  const std::vector<uint64_t> &nodes_per_depth() const { return nodes; }
+  const std::vector<uint64_t> &children_per_depth() const { return children; }
+  const std::vector<uint64_t> &time_ns_per_depth() const { return time_ns; }
+  const std::vector<uint64_t> &dead_ends_per_column() const {
+    return dead_ends;
+  }
+
+  std::string ToJson() const {
+    std::stringstream out;
+    const auto write_array = [&](const std::vector<uint64_t> &v) {
+      out << "[";
+      for (std::size_t i = 0; i < v.size(); ++i) {
+        out << (i == 0 ? "" : ",") << v[i];
+      }
+      out << "]";
+    };
+    out << "{\"nodes\":";
+    write_array(nodes);
+    out << ",\"children\":";
+    write_array(children);
+    out << ",\"branching_factor\":[";
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      out << (i == 0 ? "" : ",")
+          << (nodes[i] == 0 ? 0.0
+                            : static_cast<double>(children[i]) / nodes[i]);
+    }
+    out << "],\"time_ns\":";
+    write_array(time_ns);
+    out << ",\"dead_ends\":{";
+    bool first = true;
+    for (std::size_t col = 0; col < dead_ends.size(); ++col) {
+      if (dead_ends[col] != 0) {
+        out << (first ? "" : ",") << "\"" << col << "\":" << dead_ends[col];
+        first = false;
+      }
+    }
+    out << "}}";
+    return out.str();
+  }
+
+private:
+  static void AddTo(std::vector<uint64_t> &a, const std::vector<uint64_t> &b) {
+    if (a.size() < b.size()) {
+      a.resize(b.size());
+    }
+    for (std::size_t i = 0; i < b.size(); ++i) {
+      a[i] += b[i];
+    }
+  }
+
+  std::size_t depth{};
+  std::vector<uint64_t> nodes;
+  std::vector<uint64_t> children;
+  std::vector<uint64_t> time_ns;
+  std::vector<uint64_t> dead_ends;
+};
+
+using SearchStats = BasicSearchStats<kSearchStatsEnabled>;
@@ -0,0 +1,57 @@
+#include "search_stats.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+// a root with two children, the first one a dead end on column 3
+void WalkTree(BasicSearchStats<true> &stats) {
+  BasicSearchStats<true>::NodeScope root(stats);
+  stats.AddChildren(2);
+  {
+    BasicSearchStats<true>::NodeScope child(stats);
+    stats.DeadEnd(3);
+  }
+  {
+    BasicSearchStats<true>::NodeScope child(stats);
+    stats.AddChildren(1);
+    BasicSearchStats<true>::NodeScope grandchild(stats);
+  }
+}
+} // namespace
+
+TEST(SearchStats, CountsPerDepth) {
+  BasicSearchStats<true> stats;
+  WalkTree(stats);
+  EXPECT_THAT(stats.nodes_per_depth(), testing::ElementsAre(1, 2, 1));
+  EXPECT_THAT(stats.children_per_depth(), testing::ElementsAre(2, 1, 0));
+  EXPECT_THAT(stats.dead_ends_per_column(), testing::ElementsAre(0, 0, 0, 1));
+  EXPECT_EQ(stats.time_ns_per_depth().size(), 3u);
+  // time below a node includes the time below its children
+  EXPECT_GE(stats.time_ns_per_depth()[0], stats.time_ns_per_depth()[1]);
+}
+
+TEST(SearchStats, Merge) {
+  BasicSearchStats<true> stats;
+  BasicSearchStats<true> other;
+  WalkTree(stats);
+  WalkTree(other);
+  stats.Merge(other);
+  EXPECT_THAT(stats.nodes_per_depth(), testing::ElementsAre(2, 4, 2));
+  stats.Clear();
+  EXPECT_TRUE(stats.nodes_per_depth().empty());
+}
+
+TEST(SearchStats, ToJson) {
+  BasicSearchStats<true> stats;
+  WalkTree(stats);
+  const std::string json = stats.ToJson();
+  EXPECT_THAT(json, testing::HasSubstr("\"nodes\":[1,2,1]"));
+  EXPECT_THAT(json, testing::HasSubstr("\"branching_factor\":[2,0.5,0]"));
+  EXPECT_THAT(json, testing::HasSubstr("\"dead_ends\":{\"3\":1}"));
+
+  BasicSearchStats<false> disabled;
+  BasicSearchStats<false>::NodeScope node(disabled);
+  disabled.DeadEnd(3);
+  EXPECT_EQ(disabled.ToJson(), "{}");
+}
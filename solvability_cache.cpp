@@ -0,0 +1,66 @@
+#include "solvability_cache.hpp"
+
+SolvabilityCache::SolvabilityCache(std::size_t log2_slots,
+                                   std::size_t log2_shards)
+    : shards(std::size_t{1} << log2_shards), shift(64 - log2_shards),
+      slot_mask((uint64_t{1} << (log2_slots - log2_shards)) - 1) {
+  for (auto &shard : shards) {
+    shard.slots = std::make_unique<Slot[]>(slot_mask + 1);
+  }
+}
+
+uint64_t SolvabilityCache::Hash(const Key &key) {
+  uint64_t x = key.hi * 0x9e3779b97f4a7c15ULL ^ key.lo;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+SolvabilityCache::Result SolvabilityCache::Find(const Key &key) const {
+  const uint64_t hash = Hash(key);
+  const Shard &shard = ShardOf(hash);
+  shard.lookups.fetch_add(1, std::memory_order_relaxed);
+  const Slot &slot = SlotOf(shard, hash);
+  const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+  if (seq & 1) {
+    return Result::UNKNOWN;
+  }
+  const uint64_t hi = slot.hi.load(std::memory_order_relaxed);
+  const uint64_t lo = slot.lo.load(std::memory_order_relaxed);
+  const Result result = slot.result.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.seq.load(std::memory_order_relaxed) != seq || hi != key.hi ||
+      lo != key.lo || result == Result::UNKNOWN) {
+    return Result::UNKNOWN;
+  }
+  shard.hits.fetch_add(1, std::memory_order_relaxed);
+  return result;
+}
+
+void SolvabilityCache::Store(const Key &key, Result result) {
+  const uint64_t hash = Hash(key);
+  Shard &shard = shards[hash >> shift];
+  Slot &slot = SlotOf(shard, hash);
+  uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+  if ((seq & 1) || !slot.seq.compare_exchange_strong(
+                       seq, seq + 1, std::memory_order_acquire)) {
+    // someone else is writing the slot, this entry is lost
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.hi.store(key.hi, std::memory_order_relaxed);
+  slot.lo.store(key.lo, std::memory_order_relaxed);
+  slot.result.store(result, std::memory_order_relaxed);
+  slot.seq.store(seq + 2, std::memory_order_release);
+  shard.stores.fetch_add(1, std::memory_order_relaxed);
+}
+
+SolvabilityCache::Stats SolvabilityCache::stats() const {
+  Stats result;
+  for (const auto &shard : shards) {
+    result.lookups += shard.lookups.load(std::memory_order_relaxed);
+    result.hits += shard.hits.load(std::memory_order_relaxed);
+    result.stores += shard.stores.load(std::memory_order_relaxed);
+  }
+  return result;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Bounded cache of whether a residual puzzle (empty cells and the pieces left
+// to place them) can be solved, shared by all solver threads. Like
+// TranspositionTable it is lossy: every key has one slot, a store overwrites
+// it. Slots are guarded by sequence locks, lookups never block and writers
+// skip a slot that is being written instead of waiting for it.
+//
+// The slots are split into shards, each with its own hit counters, so that
+// threads counting hits don't share cache lines.
+class SolvabilityCache {
+public:
+  enum class Result : uint8_t { UNKNOWN, SOLVABLE, UNSOLVABLE };
+  struct Key {
+    uint64_t hi;
+    uint64_t lo;
+  };
+  struct Stats {
+    uint64_t lookups{};
+    uint64_t hits{};
+    uint64_t stores{};
+    double hit_rate() const {
+      return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+  };
+
+  // 2^log2_slots slots in 2^log2_shards shards.
+  explicit SolvabilityCache(std::size_t log2_slots = 20,
+                            std::size_t log2_shards = 6);
+
+  Result Find(const Key &key) const;
+  void Store(const Key &key, Result result);
+
+  // sums of the counters of all shards, relaxed reads
+  Stats stats() const;
+
+private:
+  struct Slot {
+    // odd while a writer is in the slot
+    std::atomic<uint32_t> seq{};
+    std::atomic<uint64_t> hi{};
+    std::atomic<uint64_t> lo{};
+    std::atomic<Result> result{Result::UNKNOWN};
+  };
+  struct alignas(64) Shard {
+    std::unique_ptr<Slot[]> slots;
+    mutable std::atomic<uint64_t> lookups{};
+    mutable std::atomic<uint64_t> hits{};
+    std::atomic<uint64_t> stores{};
+  };
+
+  static uint64_t Hash(const Key &key);
+  const Shard &ShardOf(uint64_t hash) const { return shards[hash >> shift]; }
+  Slot &SlotOf(const Shard &shard, uint64_t hash) const {
+    return shard.slots[hash & slot_mask];
+  }
+
+  std::vector<Shard> shards;
+  // the top bits of the hash pick the shard, the bottom ones the slot
+  std::size_t shift;
+  uint64_t slot_mask;
+};
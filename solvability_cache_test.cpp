@@ -0,0 +1,49 @@
+#include "solvability_cache.hpp"
+
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+namespace {
+SolvabilityCache::Result ResultOf(uint64_t i) {
+  return i % 3 == 0 ? SolvabilityCache::Result::SOLVABLE
+                    : SolvabilityCache::Result::UNSOLVABLE;
+}
+} // namespace
+
+TEST(SolvabilityCache, FindsStoredResults) {
+  SolvabilityCache cache(8, 2);
+  EXPECT_EQ(cache.Find({1, 2}), SolvabilityCache::Result::UNKNOWN);
+  cache.Store({1, 2}, SolvabilityCache::Result::UNSOLVABLE);
+  EXPECT_EQ(cache.Find({1, 2}), SolvabilityCache::Result::UNSOLVABLE);
+  EXPECT_EQ(cache.Find({2, 1}), SolvabilityCache::Result::UNKNOWN);
+
+  const auto stats = cache.stats();
+  EXPECT_EQ(stats.lookups, 3u);
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.stores, 1u);
+  EXPECT_DOUBLE_EQ(stats.hit_rate(), 1.0 / 3);
+}
+
+TEST(SolvabilityCache, ConcurrentAccess) {
+  // lookups racing with stores never see a result of another key
+  SolvabilityCache cache(6, 2);
+  std::vector<std::thread> threads;
+  for (uint64_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t]() {
+      for (uint64_t i = 0; i < 20000; ++i) {
+        const uint64_t k = (i * 4 + t) % 1000;
+        const auto found = cache.Find({k, ~k});
+        if (found != SolvabilityCache::Result::UNKNOWN) {
+          EXPECT_EQ(found, ResultOf(k));
+        }
+        cache.Store({k, ~k}, ResultOf(k));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_GT(cache.stats().hits, 0u);
+}
@@ -0,0 +1,169 @@
+#include "solver_cost_model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace {
+constexpr char kHeader[] = "solver_cost_model";
+constexpr int kVersion = 1;
+// Ridge term of the fit. The features are far from independent (the
+// possibilities are about pieces * placements per piece), without it a
+// small calibration set gives wild weights.
+constexpr double kRidge = 1e-3;
+} // namespace
+
+SolverCostModel SolverCostModel::Default() {
+  return SolverCostModel({{
+      // DLX
+      {-18.8, 0.403, -0.876, 0.428, -0.0358, -0.0219, 2.48},
+      // BF
+      {-30.3, 0.344, 1.40, 1.82, -0.376, -0.105, 2.83},
+      // BITSET
+      {-25.9, 0.168, 0.868, 1.21, -0.179, -0.238, 1.01},
+  }});
+}
+
+std::array<double, SolverCostModel::kVariance>
+SolverCostModel::Vector(const Features &features) {
+  return {1.0,
+          features.cells,
+          features.pieces,
+          features.log2_placements_per_piece,
+          features.log2_possibilities,
+          features.repeated_pieces};
+}
+
+SolverCostModel SolverCostModel::Fit(const std::vector<Sample> &samples,
+                                     const SolverCostModel &other) {
+  constexpr std::size_t kDim = kVariance;
+  auto weights = other.weights_;
+  for (std::size_t backend = 0; backend < kNumBackends; ++backend) {
+    // normal equations (X^T X + kRidge I) w = X^T y, the constant term is
+    // not regularized
+    std::array<std::array<double, kDim + 1>, kDim> system{};
+    std::size_t count = 0;
+    for (const auto &sample : samples) {
+      if (sample.backend != backend || !(sample.seconds > 0)) {
+        continue;
+      }
+      ++count;
+      const auto x = Vector(sample.features);
+      const double y = std::log2(sample.seconds);
+      for (std::size_t i = 0; i < kDim; ++i) {
+        for (std::size_t j = 0; j < kDim; ++j) {
+          system[i][j] += x[i] * x[j];
+        }
+        system[i][kDim] += x[i] * y;
+      }
+    }
+    if (count == 0) {
+      continue;
+    }
+    for (std::size_t i = 1; i < kDim; ++i) {
+      system[i][i] += kRidge * count;
+    }
+    // Gauss-Jordan elimination with partial pivoting
+    bool singular = false;
+    for (std::size_t col = 0; col < kDim && !singular; ++col) {
+      std::size_t pivot = col;
+      for (std::size_t row = col + 1; row < kDim; ++row) {
+        if (std::abs(system[row][col]) > std::abs(system[pivot][col])) {
+          pivot = row;
+        }
+      }
+      if (std::abs(system[pivot][col]) < 1e-12) {
+        singular = true;
+        break;
+      }
+      std::swap(system[col], system[pivot]);
+      for (std::size_t row = 0; row < kDim; ++row) {
+        if (row == col) {
+          continue;
+        }
+        const double factor = system[row][col] / system[col][col];
+        for (std::size_t k = col; k <= kDim; ++k) {
+          system[row][k] -= factor * system[col][k];
+        }
+      }
+    }
+    if (singular) {
+      continue;
+    }
+    Weights fitted{};
+    for (std::size_t i = 0; i < kDim; ++i) {
+      fitted[i] = system[i][kDim] / system[i][i];
+    }
+    double squared_residuals = 0;
+    for (const auto &sample : samples) {
+      if (sample.backend != backend || !(sample.seconds > 0)) {
+        continue;
+      }
+      const auto x = Vector(sample.features);
+      double residual = std::log2(sample.seconds);
+      for (std::size_t i = 0; i < kDim; ++i) {
+        residual -= fitted[i] * x[i];
+      }
+      squared_residuals += residual * residual;
+    }
+    fitted[kVariance] = squared_residuals / count;
+    weights[backend] = fitted;
+  }
+  return SolverCostModel(weights);
+}
+
+double SolverCostModel::PredictLog2Seconds(std::size_t backend,
+                                           const Features &features) const {
+  const auto x = Vector(features);
+  double result = 0;
+  for (std::size_t i = 0; i < kVariance; ++i) {
+    result += weights_[backend][i] * x[i];
+  }
+  // mean of a log-normal distribution: log2 E[t] = mu + ln(2) sigma^2 / 2
+  return result + std::log(2.0) * weights_[backend][kVariance] / 2;
+}
+
+std::size_t SolverCostModel::Cheapest(const Features &features) const {
+  std::size_t best = 0;
+  double best_cost = PredictLog2Seconds(0, features);
+  for (std::size_t backend = 1; backend < kNumBackends; ++backend) {
+    const double cost = PredictLog2Seconds(backend, features);
+    if (cost < best_cost) {
+      best = backend;
+      best_cost = cost;
+    }
+  }
+  return best;
+}
+
+void SolverCostModel::Save(std::ostream &out) const {
+  const auto precision = out.precision(17);
+  out << kHeader << " " << kVersion << "\n";
+  for (const auto &backend : weights_) {
+    for (std::size_t i = 0; i < kNumWeights; ++i) {
+      out << (i == 0 ? "" : " ") << backend[i];
+    }
+    out << "\n";
+  }
+  out.precision(precision);
+}
+
+std::optional<SolverCostModel> SolverCostModel::Load(std::istream &in) {
+  std::string header;
+  int version = 0;
+  if (!(in >> header >> version) || header != kHeader ||
+      version != kVersion) {
+    return std::nullopt;
+  }
+  std::array<Weights, kNumBackends> weights{};
+  for (auto &backend : weights) {
+    for (auto &weight : backend) {
+      if (!(in >> weight) || !std::isfinite(weight)) {
+        return std::nullopt;
+      }
+    }
+  }
+  return SolverCostModel(weights);
+}
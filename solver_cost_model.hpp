@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+// Predicts how long each backend of PuzzleSolver takes to solve a
+// configuration, so that Algoritm::AUTO can dispatch to the cheapest one.
+// The model is linear in the features of the configuration and predicts the
+// log2 of the time in seconds. The times scatter around the prediction, the
+// more so for backends that are fast on some configurations and slow on
+// similar ones, and the cost of a backend is its expected time given that
+// scatter. Its weights can be fitted from timings taken
+// on the host (puzzle_solver_bench --calibrate), the defaults were fitted
+// on an AVX-512 x86 machine.
+class SolverCostModel {
+public:
+  // indexed like PuzzleSolver::Algoritm: DLX, BF, BITSET
+  static constexpr std::size_t kNumBackends = 3;
+
+  struct Features {
+    // cells of the board
+    double cells{};
+    // number of pieces
+    double pieces{};
+    // log2 of the mean number of placements of a piece
+    double log2_placements_per_piece{};
+    // PuzzleParams::possibilities_for_configuration
+    double log2_possibilities{};
+    // pieces that are copies of an earlier piece
+    double repeated_pieces{};
+  };
+  // constant term, the weights of the features in declaration order and the
+  // variance of the log2 times around the prediction
+  static constexpr std::size_t kNumWeights = 7;
+  using Weights = std::array<double, kNumWeights>;
+
+  // A timing of one backend on a configuration.
+  struct Sample {
+    Features features;
+    std::size_t backend;
+    double seconds;
+  };
+
+  static SolverCostModel Default();
+  // Least squares fit of the log2 of the timings. Backends without samples
+  // keep the weights of other.
+  static SolverCostModel Fit(const std::vector<Sample> &samples,
+                             const SolverCostModel &other = Default());
+
+  // log2 of the expected time
+  double PredictLog2Seconds(std::size_t backend,
+                            const Features &features) const;
+  std::size_t Cheapest(const Features &features) const;
+
+  const Weights &weights(std::size_t backend) const {
+    return weights_[backend];
+  }
+
+  // Plain text, one line of weights per backend.
+  void Save(std::ostream &out) const;
+  static std::optional<SolverCostModel> Load(std::istream &in);
+
+private:
+  explicit SolverCostModel(
+      const std::array<Weights, kNumBackends> &weights)
+      : weights_(weights) {}
+
+  static constexpr std::size_t kVariance = kNumWeights - 1;
+  // constant term, then the features in declaration order
+  static std::array<double, kVariance> Vector(const Features &features);
+
+  std::array<Weights, kNumBackends> weights_;
+};
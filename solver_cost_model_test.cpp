@@ -0,0 +1,75 @@
+#include "solver_cost_model.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <sstream>
+
+TEST(SolverCostModel, FitRecoversLinearCosts) {
+  // DLX is slow, BF gets slower with every piece, BITSET with the
+  // possibilities
+  std::vector<SolverCostModel::Sample> samples;
+  for (int pieces = 2; pieces < 12; ++pieces) {
+    for (int placements = 1; placements < 6; ++placements) {
+      SolverCostModel::Features features{
+          .pieces = static_cast<double>(pieces),
+          .log2_placements_per_piece = static_cast<double>(placements),
+          .log2_possibilities = static_cast<double>(pieces * placements),
+          .repeated_pieces = static_cast<double>(pieces % 3)};
+      samples.push_back({features, 0, std::exp2(-10.0)});
+      samples.push_back({features, 1, std::exp2(-20.0 + pieces)});
+      samples.push_back(
+          {features, 2, std::exp2(-18.0 + 0.25 * features.log2_possibilities)});
+    }
+  }
+  const auto model = SolverCostModel::Fit(samples);
+  const SolverCostModel::Features few{.pieces = 3,
+                                      .log2_placements_per_piece = 4,
+                                      .log2_possibilities = 12};
+  const SolverCostModel::Features many{.pieces = 10,
+                                       .log2_placements_per_piece = 1,
+                                       .log2_possibilities = 10};
+  EXPECT_NEAR(model.PredictLog2Seconds(0, few), -10, 0.1);
+  EXPECT_NEAR(model.PredictLog2Seconds(1, few), -17, 0.1);
+  EXPECT_NEAR(model.PredictLog2Seconds(2, many), -15.5, 0.1);
+  EXPECT_EQ(model.Cheapest(few), 1u);
+  EXPECT_EQ(model.Cheapest(many), 2u);
+}
+
+TEST(SolverCostModel, FitKeepsBackendsWithoutSamples) {
+  const std::vector<SolverCostModel::Sample> samples = {
+      {{.pieces = 2}, 1, 1e-6}, {{.pieces = 4}, 1, 4e-6}};
+  const auto model = SolverCostModel::Fit(samples);
+  EXPECT_EQ(model.weights(0), SolverCostModel::Default().weights(0));
+  EXPECT_EQ(model.weights(2), SolverCostModel::Default().weights(2));
+  EXPECT_NE(model.weights(1), SolverCostModel::Default().weights(1));
+}
+
+TEST(SolverCostModel, ExpectedTimeGrowsWithScatter) {
+  // same median time, BF is sometimes much faster and sometimes much slower
+  std::vector<SolverCostModel::Sample> samples;
+  for (int i = 0; i < 10; ++i) {
+    samples.push_back({{}, 0, 1e-5});
+    samples.push_back({{}, 1, i % 2 == 0 ? 1e-6 : 1e-4});
+    samples.push_back({{}, 2, 2e-5});
+  }
+  const auto model = SolverCostModel::Fit(samples);
+  EXPECT_EQ(model.Cheapest({}), 0u);
+  EXPECT_GT(model.PredictLog2Seconds(1, {}), model.PredictLog2Seconds(2, {}));
+}
+
+TEST(SolverCostModel, SaveAndLoad) {
+  const auto model = SolverCostModel::Default();
+  std::stringstream stream;
+  model.Save(stream);
+  const auto loaded = SolverCostModel::Load(stream);
+  ASSERT_TRUE(loaded);
+  for (std::size_t b = 0; b < SolverCostModel::kNumBackends; ++b) {
+    EXPECT_EQ(loaded->weights(b), model.weights(b));
+  }
+
+  std::stringstream truncated("solver_cost_model 1\n1 2 3\n");
+  EXPECT_FALSE(SolverCostModel::Load(truncated));
+  std::stringstream other("something else");
+  EXPECT_FALSE(SolverCostModel::Load(other));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Fixed-size, lossy hash table from search states to values. Every key maps
+// to a single slot and a store overwrites whatever was in it, so lookups can
+// miss states that were stored before but never return a wrong value.
+//
+// Entries are stored under a generation and only found under the same one.
+// NewGeneration() forgets all entries in O(1), which lets one table be reused
+// between searches without clearing it.
+template <typename VALUE> class TranspositionTable {
+public:
+  struct Key {
+    uint64_t hi;
+    uint64_t lo;
+    bool operator==(const Key &other) const = default;
+  };
+
+  // The table has 2^log2_size slots.
+  explicit TranspositionTable(std::size_t log2_size)
+      : slots(std::size_t{1} << log2_size), mask(slots.size() - 1) {}
+
+  uint32_t NewGeneration() {
+    if (++generation == 0) {
+      // generation 0 marks empty slots, start over once it wraps around
+      for (auto &slot : slots) {
+        slot.generation = 0;
+      }
+      generation = 1;
+    }
+    return generation;
+  }
+
+  std::optional<VALUE> Find(const Key &key, uint32_t generation) const {
+    const Slot &slot = slots[Hash(key) & mask];
+    if (slot.generation != generation || !(slot.key == key)) {
+      return std::nullopt;
+    }
+    return slot.value;
+  }
+
+  void Store(const Key &key, uint32_t generation, const VALUE &value) {
+    slots[Hash(key) & mask] = Slot{key, generation, value};
+  }
+
+  std::size_t size() const { return slots.size(); }
+
+private:
+  struct Slot {
+    Key key{};
+    uint32_t generation{};
+    VALUE value{};
+  };
+
+  // splitmix64 finalizer of both halves
+  static uint64_t Hash(const Key &key) {
+    uint64_t x = key.hi * 0x9e3779b97f4a7c15ULL ^ key.lo;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  std::vector<Slot> slots;
+  std::size_t mask;
+  uint32_t generation{};
+};
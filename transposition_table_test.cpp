@@ -0,0 +1,40 @@
+#include "transposition_table.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(TranspositionTable, FindsStoredValues) {
+  TranspositionTable<int> table(4);
+  const uint32_t generation = table.NewGeneration();
+  EXPECT_FALSE(table.Find({1, 2}, generation));
+  table.Store({1, 2}, generation, 42);
+  EXPECT_EQ(table.Find({1, 2}, generation), 42);
+  EXPECT_FALSE(table.Find({2, 1}, generation));
+}
+
+TEST(TranspositionTable, NewGenerationForgets) {
+  TranspositionTable<int> table(4);
+  const uint32_t first = table.NewGeneration();
+  table.Store({1, 2}, first, 42);
+  const uint32_t second = table.NewGeneration();
+  EXPECT_FALSE(table.Find({1, 2}, second));
+  // the old generation can still be looked up until it is overwritten
+  EXPECT_EQ(table.Find({1, 2}, first), 42);
+}
+
+TEST(TranspositionTable, Lossy) {
+  // more keys than slots, some are overwritten but none is found wrongly
+  TranspositionTable<uint64_t> table(2);
+  const uint32_t generation = table.NewGeneration();
+  for (uint64_t i = 0; i < 16; ++i) {
+    table.Store({i, 0}, generation, i);
+  }
+  int found = 0;
+  for (uint64_t i = 0; i < 16; ++i) {
+    if (const auto value = table.Find({i, 0}, generation)) {
+      EXPECT_EQ(*value, i);
+      ++found;
+    }
+  }
+  EXPECT_GT(found, 0);
+  EXPECT_LE(found, 4);
+}